@@ -0,0 +1,289 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "../headers/device.h"
+#include "../headers/graphics.h"
+
+// every allocation through operator new of any thread, the steady state of draw must leave it unchanged
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    allocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+struct AllocBenchOptions
+{
+    uint32_t frames{1000};
+    uint32_t warmup{16}; // records every command buffer and runs every one-off resize first
+    uint32_t stream{256}; // frames that each follow a mesh streamed in while drawing
+    uint32_t grow{256};   // frames that each follow an object getting one more instance
+    bool indirect{false};
+    bool cull{false};
+    bool validation{false};
+    std::string shaders{"../glfw_example/shaders/"};
+};
+
+static void parseOptions(int argc, char **argv, AllocBenchOptions &options)
+{
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--indirect")
+        {
+            options.indirect = true;
+            continue;
+        }
+        if (option == "--cull")
+        {
+            options.indirect = true;
+            options.cull = true;
+            continue;
+        }
+        if (option == "--validation")
+        {
+            options.validation = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            throw std::runtime_error("missing value for " + option);
+        std::string value = argv[++i];
+        if (option == "--frames")
+            options.frames = std::stoul(value);
+        else if (option == "--warmup")
+            options.warmup = std::stoul(value);
+        else if (option == "--stream")
+            options.stream = std::stoul(value);
+        else if (option == "--grow")
+            options.grow = std::stoul(value);
+        else if (option == "--shaders")
+            options.shaders = value;
+        else
+            throw std::runtime_error("unknown option " + option);
+    }
+
+    if (options.frames == 0)
+        throw std::runtime_error("--frames needs to be at least 1");
+    if (!options.shaders.empty() && options.shaders.back() != '/')
+        options.shaders += '/';
+}
+
+// a wavy grid of size * size quads in the unit square
+static void generateGrid(uint32_t size, std::vector<Cthovk::Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+    for (uint32_t y{0}; y <= size; ++y)
+    {
+        for (uint32_t x{0}; x <= size; ++x)
+        {
+            float u = static_cast<float>(x) / size;
+            float v = static_cast<float>(y) / size;
+            vertices.push_back({
+                .pos = {u - 0.5f, v - 0.5f, 0.05f * std::sin(10.0f * u)},
+                .color = {u, v, 1.0f - u},
+            });
+        }
+    }
+    for (uint32_t y{0}; y < size; ++y)
+    {
+        for (uint32_t x{0}; x < size; ++x)
+        {
+            uint32_t a = y * (size + 1) + x;
+            uint32_t c = a + size + 2;
+            indices.insert(indices.end(), {a, a + 1, c, a, c, a + size + 1});
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    AllocBenchOptions options;
+    try
+    {
+        parseOptions(argc, argv, options);
+
+        Cthovk::Device device(Cthovk::DeviceInfo{
+            .enableVL = options.validation,
+            .vl = {"VK_LAYER_KHRONOS_validation"},
+        });
+        // moves the whole scene every frame through each kind of update draw supports
+        float time{0.0f};
+        Cthovk::GraphicsInfo graphicsInfo{
+            .getFrameBufferSize = [](uint32_t &width, uint32_t &height) {
+                width = 640;
+                height = 480;
+            },
+            .vertShaderLocation = options.shaders + "shader.vert.spv",
+            .fragShaderLocation = options.shaders + "shader.frag.spv",
+            .multiSampleCount = VK_SAMPLE_COUNT_1_BIT,
+            .framesInFlight = 2,
+            .clearValue = {{{0.02f, 0.0f, 0.03f, 1.0f}}},
+            .updateCamera =
+                [&](Cthovk::CameraData &camera, Cthovk::SwapChainObj &sc) {
+                    time += 1.0f / 60.0f;
+                    camera.view = glm::lookAt(glm::vec3(2.0f * std::cos(time), 2.0f * std::sin(time), 1.5f),
+                                              glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+                    camera.proj = glm::perspective(glm::radians(45.0f),
+                                                   sc.extent.width / static_cast<float>(sc.extent.height), 0.01f,
+                                                   100.0f);
+                    camera.proj[1][1] *= -1;
+                },
+            // the parent below is the first object added and takes the first slot
+            .updateTransforms =
+                [&](Cthovk::TransformBatchObj &transforms, Cthovk::SwapChainObj &) {
+                    transforms.rotationZ[0] = std::sin(time);
+                    transforms.rotationW[0] = std::cos(time);
+                },
+            .indirectDraw = options.indirect,
+            .indirectVertShaderLocation = options.shaders + "indirect.vert.spv",
+            .cullShaderLocation = options.cull ? options.shaders + "cull.comp.spv" : "",
+            .lodRatios = {0.25f},
+        };
+        Cthovk::Graphics graphics(device.logDevice, device.phyDevice, device.surface, device.findDepthFormat(),
+                                  device.queues, device.features, graphicsInfo);
+
+        std::vector<Cthovk::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        generateGrid(32, vertices, indices);
+        Cthovk::MeshHandle triangles = graphics.addMesh(vertices, indices, Cthovk::VertexFormat::Float32,
+                                                        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        Cthovk::MeshHandle points = graphics.addMesh(vertices, {});
+
+        // a transformed parent with an instanced child, an object updated through its ubo and one left alone
+        Cthovk::ObjectHandle parent = graphics.addObject(triangles, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        Cthovk::ObjectHandle child = graphics.addObject(triangles, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        graphics.setTransform(parent, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+        graphics.setTransform(child, glm::vec3(0.0f, 0.0f, 0.5f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                              glm::vec3(0.5f));
+        graphics.setParent(child, parent);
+        std::vector<Cthovk::InstanceData> instances(64);
+        for (uint32_t i{0}; i < instances.size(); ++i)
+        {
+            instances[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.5f * i));
+        }
+        graphics.setInstances(child, instances);
+        graphics.addObject(points, VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+                           [&](Cthovk::UniformBufferObject &ubo, Cthovk::SwapChainObj &) {
+                               ubo.model = glm::rotate(glm::mat4(1.0f), time, glm::vec3(1.0f, 0.0f, 0.0f));
+                           });
+        graphics.addObject(points, VK_PRIMITIVE_TOPOLOGY_LINE_STRIP);
+        graphics.waitUploads();
+
+        for (uint32_t i{0}; i < options.warmup; ++i)
+        {
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+        }
+        uint64_t before = allocations;
+        for (uint32_t i{0}; i < options.frames; ++i)
+        {
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+        }
+        uint64_t drawAllocations = allocations - before;
+
+        // replaces an object with one drawing a freshly added mesh before every frame, registering allocates but
+        // the draws submitting and handing off its uploads and recording the changed scene must not
+        std::vector<Cthovk::Vertex> streamedVertices;
+        std::vector<uint32_t> streamedIndices;
+        generateGrid(8, streamedVertices, streamedIndices);
+        Cthovk::ObjectHandle streamed = graphics.addObject(triangles, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        graphics.setInstances(streamed, instances);
+        graphics.waitUploads();
+        for (uint32_t i{0}; i < options.warmup; ++i)
+        {
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+        }
+        uint64_t streamAllocations{0};
+        for (uint32_t i{0}; i < options.stream; ++i)
+        {
+            graphics.removeObject(streamed);
+            Cthovk::MeshHandle mesh = graphics.addMesh(streamedVertices, streamedIndices,
+                                                       Cthovk::VertexFormat::Float32,
+                                                       VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+            streamed = graphics.addObject(mesh, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+            graphics.setInstances(streamed, instances);
+            before = allocations;
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+            streamAllocations += allocations - before;
+        }
+
+        // adds an instance to an object before every frame, its instance buffers outgrow their capacity again and
+        // again but only setInstances may replace them
+        uint64_t growAllocations{0};
+        for (uint32_t i{0}; i < options.grow; ++i)
+        {
+            instances.push_back({glm::translate(glm::mat4(1.0f), glm::vec3(0.1f * (i + 1), 0.0f, 0.0f))});
+            graphics.setInstances(streamed, instances);
+            before = allocations;
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+            growAllocations += allocations - before;
+        }
+        graphics.flushFrames();
+
+        std::printf("{\n  \"frames\": %u,\n  \"streamed\": %u,\n  \"grown\": %u,\n  \"indirect\": %s,\n"
+                    "  \"cull\": %s,\n  \"allocations\": %llu,\n  \"streamAllocations\": %llu,\n"
+                    "  \"growAllocations\": %llu\n}\n",
+                    options.frames, options.stream, options.grow, options.indirect ? "true" : "false",
+                    options.cull ? "true" : "false", static_cast<unsigned long long>(drawAllocations),
+                    static_cast<unsigned long long>(streamAllocations),
+                    static_cast<unsigned long long>(growAllocations));
+        if (drawAllocations != 0 || streamAllocations != 0 || growAllocations != 0)
+        {
+            std::fprintf(stderr,
+                         "draw allocated %llu times in %u frames, %llu times in %u streaming ones and %llu times in "
+                         "%u growing ones\n",
+                         static_cast<unsigned long long>(drawAllocations), options.frames,
+                         static_cast<unsigned long long>(streamAllocations), options.stream,
+                         static_cast<unsigned long long>(growAllocations), options.grow);
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
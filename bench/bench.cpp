@@ -0,0 +1,432 @@
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+
+#include "../headers/device.h"
+#include "../headers/graphics.h"
+
+// what the generated scene looks like and how long it is drawn, every run with the same options draws the same scene
+struct BenchOptions
+{
+    uint32_t meshes{16};
+    uint32_t instances{64};      // per mesh
+    uint32_t vertices{4096};     // per mesh, rounded to a grid
+    std::string topologies{"t"}; // mesh i is drawn with topologies[i % size], t triangles, l lines, p points
+    uint32_t msaa{1};
+    uint32_t frames{500};
+    uint32_t warmup{20};
+    uint32_t width{1280};
+    uint32_t height{720};
+    uint32_t seed{1};
+    bool optimize{false};        // reorders the meshes for the vertex cache before uploading them
+    std::string format{"float32"}; // vertex format of every mesh, float32, half or snorm16
+    bool indirect{false};
+    bool cull{false};
+    bool meshlets{false};        // culls the meshlets of every triangle list mesh on their own
+    bool backFaceCulling{false}; // the generated meshes are closed, every triangle faces outward
+    std::vector<float> lods;     // fractions of the triangles of every level of detail below the mesh itself
+    float lodPixels{1.0f};
+    float lodHysteresis{0.0f};
+    uint32_t threads{1};
+    bool spin{false}; // every mesh turns about its own axis every frame through the batched transforms
+    bool validation{false};
+    std::string shaders{"../glfw_example/shaders/"};
+    std::string output; // empty writes the report to stdout
+};
+
+// std::mt19937 yields the same sequence everywhere, the standard distributions do not
+class SceneRandom
+{
+  public:
+    SceneRandom(uint32_t seed) : engine(seed)
+    {
+    }
+
+    float next(float min, float max)
+    {
+        return min + (max - min) * static_cast<float>(engine() >> 8) / 16777216.0f;
+    }
+
+  private:
+    std::mt19937 engine;
+};
+
+static void parseOptions(int argc, char **argv, BenchOptions &options)
+{
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--optimize")
+        {
+            options.optimize = true;
+            continue;
+        }
+        if (option == "--indirect")
+        {
+            options.indirect = true;
+            continue;
+        }
+        if (option == "--cull")
+        {
+            options.indirect = true;
+            options.cull = true;
+            continue;
+        }
+        if (option == "--meshlets")
+        {
+            options.indirect = true;
+            options.cull = true;
+            options.meshlets = true;
+            continue;
+        }
+        if (option == "--backface-culling")
+        {
+            options.backFaceCulling = true;
+            continue;
+        }
+        if (option == "--spin")
+        {
+            options.spin = true;
+            continue;
+        }
+        if (option == "--validation")
+        {
+            options.validation = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            throw std::runtime_error("missing value for " + option);
+        std::string value = argv[++i];
+        if (option == "--meshes")
+            options.meshes = std::stoul(value);
+        else if (option == "--instances")
+            options.instances = std::stoul(value);
+        else if (option == "--vertices")
+            options.vertices = std::stoul(value);
+        else if (option == "--topologies")
+            options.topologies = value;
+        else if (option == "--format")
+            options.format = value;
+        else if (option == "--msaa")
+            options.msaa = std::stoul(value);
+        else if (option == "--frames")
+            options.frames = std::stoul(value);
+        else if (option == "--warmup")
+            options.warmup = std::stoul(value);
+        else if (option == "--width")
+            options.width = std::stoul(value);
+        else if (option == "--height")
+            options.height = std::stoul(value);
+        else if (option == "--seed")
+            options.seed = std::stoul(value);
+        else if (option == "--lods")
+        {
+            // a comma separated list, finest first
+            for (size_t start{0}; start < value.size();)
+            {
+                size_t end = std::min(value.find(',', start), value.size());
+                options.lods.push_back(std::stof(value.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+        else if (option == "--lod-pixels")
+            options.lodPixels = std::stof(value);
+        else if (option == "--lod-hysteresis")
+            options.lodHysteresis = std::stof(value);
+        else if (option == "--threads")
+            options.threads = std::stoul(value);
+        else if (option == "--shaders")
+            options.shaders = value;
+        else if (option == "--output")
+            options.output = value;
+        else
+            throw std::runtime_error("unknown option " + option);
+    }
+
+    if (options.meshes == 0 || options.instances == 0 || options.frames == 0)
+        throw std::runtime_error("--meshes, --instances and --frames need to be at least 1");
+    if (options.topologies.empty() || options.topologies.find_first_not_of("tlp") != std::string::npos)
+        throw std::runtime_error("--topologies takes a sequence of t, l and p");
+    if (options.format != "float32" && options.format != "half" && options.format != "snorm16")
+        throw std::runtime_error("--format takes float32, half or snorm16");
+    if (options.msaa == 0 || (options.msaa & (options.msaa - 1)) != 0 || options.msaa > 64)
+        throw std::runtime_error("--msaa takes a power of two up to 64");
+    for (uint32_t i{0}; i < options.lods.size(); ++i)
+    {
+        if (options.lods[i] <= 0.0f || options.lods[i] >= (i == 0 ? 1.0f : options.lods[i - 1]))
+            throw std::runtime_error("--lods takes decreasing fractions between 0 and 1");
+    }
+    if (!options.shaders.empty() && options.shaders.back() != '/')
+        options.shaders += '/';
+}
+
+static VkPrimitiveTopology topology(char code)
+{
+    switch (code)
+    {
+    case 'l':
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case 'p':
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+static Cthovk::VertexFormat vertexFormat(const std::string &name)
+{
+    if (name == "half")
+        return Cthovk::VertexFormat::Half;
+    if (name == "snorm16")
+        return Cthovk::VertexFormat::Snorm16;
+    return Cthovk::VertexFormat::Float32;
+}
+
+// the grid a mesh of about vertexCount vertices is laid out on
+static void meshGrid(uint32_t vertexCount, uint32_t &rings, uint32_t &segments)
+{
+    rings = std::max(3u, static_cast<uint32_t>(std::sqrt(static_cast<float>(vertexCount))));
+    segments = std::max(3u, vertexCount / rings);
+}
+
+// a torus of rings * segments vertices with random radii and colors
+static void generateMesh(SceneRandom &random, uint32_t vertexCount, std::vector<Cthovk::Vertex> &vertices,
+                         std::vector<uint32_t> &indices)
+{
+    uint32_t rings, segments;
+    meshGrid(vertexCount, rings, segments);
+    float major = random.next(0.6f, 1.0f);
+    float minor = random.next(0.1f, 0.4f);
+    glm::vec3 color(random.next(0.2f, 1.0f), random.next(0.2f, 1.0f), random.next(0.2f, 1.0f));
+
+    vertices.resize(rings * segments);
+    for (uint32_t i{0}; i < rings; ++i)
+    {
+        float u = glm::radians(360.0f) * i / rings;
+        for (uint32_t j{0}; j < segments; ++j)
+        {
+            float v = glm::radians(360.0f) * j / segments;
+            vertices[i * segments + j] = {
+                .pos = {(major + minor * std::cos(v)) * std::cos(u), (major + minor * std::cos(v)) * std::sin(u),
+                        minor * std::sin(v)},
+                .color = color * (0.6f + 0.4f * std::cos(v)),
+            };
+        }
+    }
+    indices.resize(6 * rings * segments);
+    for (uint32_t i{0}; i < rings; ++i)
+    {
+        for (uint32_t j{0}; j < segments; ++j)
+        {
+            uint32_t a = i * segments + j;
+            uint32_t b = ((i + 1) % rings) * segments + j;
+            uint32_t c = ((i + 1) % rings) * segments + (j + 1) % segments;
+            uint32_t d = i * segments + (j + 1) % segments;
+            uint32_t *quad = &indices[6 * a];
+            quad[0] = a;
+            quad[1] = b;
+            quad[2] = c;
+            quad[3] = a;
+            quad[4] = c;
+            quad[5] = d;
+        }
+    }
+}
+
+// instances scattered through a unit cube, scaled so the cube stays about as full for any count
+static std::vector<Cthovk::InstanceData> generateInstances(SceneRandom &random, uint32_t count, float scale)
+{
+    std::vector<Cthovk::InstanceData> instances(count);
+    for (uint32_t i{0}; i < count; ++i)
+    {
+        glm::vec3 position(random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f));
+        glm::vec3 axis = glm::normalize(glm::vec3(random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f), 1.0f));
+        instances[i].model = glm::translate(glm::mat4(1.0f), position);
+        instances[i].model = glm::rotate(instances[i].model, random.next(0.0f, glm::radians(360.0f)), axis);
+        instances[i].model = glm::scale(instances[i].model, glm::vec3(scale));
+    }
+    return instances;
+}
+
+static double milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    try
+    {
+        parseOptions(argc, argv, options);
+
+        uint32_t rings, segments;
+        meshGrid(options.vertices, rings, segments);
+        uint32_t meshVertices = rings * segments;
+        // every level of detail is stored after the indices of its mesh
+        float lodIndices = std::accumulate(options.lods.begin(), options.lods.end(), 1.0f);
+        auto startupBegin = std::chrono::steady_clock::now();
+        Cthovk::Device device(Cthovk::DeviceInfo{
+            .enableVL = options.validation,
+            .vl = {"VK_LAYER_KHRONOS_validation"},
+        });
+        Cthovk::GraphicsInfo graphicsInfo{
+            .getFrameBufferSize = [&](uint32_t &width, uint32_t &height) {
+                width = options.width;
+                height = options.height;
+            },
+            .vertShaderLocation = options.shaders + "shader.vert.spv",
+            .fragShaderLocation = options.shaders + "shader.frag.spv",
+            .multiSampleCount = static_cast<VkSampleCountFlagBits>(options.msaa),
+            .framesInFlight = 2,
+            .clearValue = {{{0.02f, 0.0f, 0.03f, 1.0f}}},
+            .transformThreads = options.threads,
+            .maxObjects = options.meshes,
+            // meshlets of the generated meshes hold well over 32 triangles on average
+            .maxDraws = options.meshes * (meshVertices / 16 + 1 + static_cast<uint32_t>(options.lods.size())),
+            .maxVertices = options.meshes * meshVertices,
+            .maxIndices = static_cast<uint32_t>(6 * options.meshes * meshVertices * lodIndices),
+            .optimizeMeshes = options.optimize,
+            .recordThreads = options.threads,
+            .indirectDraw = options.indirect,
+            .indirectVertShaderLocation = options.shaders + "indirect.vert.spv",
+            .cullShaderLocation = options.cull ? options.shaders + "cull.comp.spv" : "",
+            .splitMeshlets = options.meshlets,
+            .lodRatios = options.lods,
+            .lodErrorPixels = options.lodPixels,
+            .lodHysteresis = options.lodHysteresis,
+            .backFaceCulling = options.backFaceCulling,
+            .gpuProfiler = true,
+            .cpuProfiler = false,
+        };
+        // meshes turn at one of eight speeds so their matrices differ from frame to frame and from each other
+        uint32_t spinFrame{0};
+        if (options.spin)
+            graphicsInfo.updateTransforms = [&](Cthovk::TransformBatchObj &transforms, Cthovk::SwapChainObj &) {
+                spinFrame++;
+                for (uint32_t i{0}; i < options.meshes; ++i)
+                {
+                    float angle = 0.005f * static_cast<float>(spinFrame * (1 + i % 8));
+                    transforms.rotationZ[i] = std::sin(angle);
+                    transforms.rotationW[i] = std::cos(angle);
+                }
+            };
+        Cthovk::Graphics graphics(device.logDevice, device.phyDevice, device.surface, device.findDepthFormat(),
+                                  device.queues, device.features, graphicsInfo);
+        auto startupEnd = std::chrono::steady_clock::now();
+
+        // the scene is generated up front so only the uploads are timed
+        SceneRandom random(options.seed);
+        std::vector<std::vector<Cthovk::Vertex>> vertices(options.meshes);
+        std::vector<std::vector<uint32_t>> indices(options.meshes);
+        std::vector<std::vector<Cthovk::InstanceData>> instances(options.meshes);
+        float scale = 0.5f / std::cbrt(static_cast<float>(options.meshes) * options.instances);
+        for (uint32_t i{0}; i < options.meshes; ++i)
+        {
+            generateMesh(random, options.vertices, vertices[i], indices[i]);
+            instances[i] = generateInstances(random, options.instances, scale);
+        }
+        Cthovk::UniformBufferObject ubo{
+            .model = glm::mat4(1.0f),
+        };
+        Cthovk::CameraData camera{
+            .view = glm::lookAt(glm::vec3(2.5f, 2.5f, 2.5f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+            .proj = glm::perspective(glm::radians(45.0f), options.width / static_cast<float>(options.height), 0.01f,
+                                     100.0f),
+        };
+        camera.proj[1][1] *= -1;
+        graphics.setCamera(camera);
+
+        auto uploadBegin = std::chrono::steady_clock::now();
+        for (uint32_t i{0}; i < options.meshes; ++i)
+        {
+            VkPrimitiveTopology meshTopology = topology(options.topologies[i % options.topologies.size()]);
+            Cthovk::MeshHandle mesh =
+                graphics.addMesh(vertices[i], indices[i], vertexFormat(options.format), meshTopology);
+            Cthovk::ObjectHandle object = graphics.addObject(mesh, meshTopology);
+            graphics.setUBO(object, ubo);
+            if (options.spin)
+                graphics.setTransform(object, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+            graphics.setInstances(object, instances[i]);
+        }
+        graphics.waitUploads();
+        auto uploadEnd = std::chrono::steady_clock::now();
+
+        // the first frames record command buffers and settle the allocator, they are left out of the numbers
+        for (uint32_t i{0}; i < options.warmup; ++i)
+        {
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+        }
+        graphics.flushFrames();
+        graphics.resetGpuStats();
+        Cthovk::CpuProfiler &profiler = graphics.getCpuProfiler();
+        profiler.setEnabled(true);
+        auto framesBegin = std::chrono::steady_clock::now();
+        uint64_t submittedTriangles{0};
+        for (uint32_t i{0}; i < options.frames; ++i)
+        {
+            graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
+            submittedTriangles += graphics.getSubmittedTriangles();
+        }
+        graphics.flushFrames();
+        auto framesEnd = std::chrono::steady_clock::now();
+        profiler.setEnabled(false);
+
+        Cthovk::CpuFrameStats cpuStats = profiler.getFrameStats();
+        Cthovk::GpuScopeStats gpuStats;
+        std::vector<Cthovk::GpuScopeStats> scopes = graphics.getGpuStats();
+        for (uint32_t i{0}; i < scopes.size(); ++i)
+        {
+            if (scopes[i].name == "render pass")
+                gpuStats = scopes[i];
+        }
+        Cthovk::MemoryStats memoryStats = graphics.getMemoryStats();
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device.phyDevice, &properties);
+
+        FILE *report = options.output.empty() ? stdout : std::fopen(options.output.c_str(), "w");
+        if (report == nullptr)
+            throw std::runtime_error("failed to open " + options.output);
+        std::fprintf(report, "{\n  \"device\": \"%s\",\n", properties.deviceName);
+        std::fprintf(report,
+                     "  \"scene\": {\"meshes\": %u, \"instances\": %u, \"vertices\": %u, \"topologies\": \"%s\", "
+                     "\"format\": \"%s\", \"msaa\": %u, \"width\": %u, \"height\": %u, \"seed\": %u, "
+                     "\"optimize\": %s, \"indirect\": %s, \"cull\": %s, \"meshlets\": %s, \"backFaceCulling\": %s, "
+                     "\"lods\": %zu, \"lodPixels\": %.3f, \"lodHysteresis\": %.3f, \"threads\": %u, \"spin\": %s, "
+                     "\"frames\": %u, \"warmup\": %u},\n",
+                     options.meshes, options.instances, meshVertices, options.topologies.c_str(),
+                     options.format.c_str(), options.msaa, options.width, options.height, options.seed,
+                     options.optimize ? "true" : "false", options.indirect ? "true" : "false",
+                     options.cull ? "true" : "false", options.meshlets ? "true" : "false",
+                     options.backFaceCulling ? "true" : "false", options.lods.size(), options.lodPixels,
+                     options.lodHysteresis, options.threads, options.spin ? "true" : "false", options.frames,
+                     options.warmup);
+        std::fprintf(report, "  \"startupMs\": %.3f,\n  \"uploadMs\": %.3f,\n", milliseconds(startupBegin, startupEnd),
+                     milliseconds(uploadBegin, uploadEnd));
+        // the mean includes waiting for the last frames in flight, the percentiles are the times between frame starts
+        std::fprintf(report,
+                     "  \"cpuMsPerFrame\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, "
+                     "\"max\": %.3f},\n",
+                     milliseconds(framesBegin, framesEnd) / options.frames, cpuStats.p50 / 1e6, cpuStats.p99 / 1e6,
+                     cpuStats.p999 / 1e6, cpuStats.maxTime / 1e6);
+        std::fprintf(report, "  \"submittedTrianglesPerFrame\": %.0f,\n",
+                     static_cast<double>(submittedTriangles) / options.frames);
+        std::fprintf(report,
+                     "  \"gpuMsPerFrame\": {\"mean\": %.3f, \"min\": %.3f, \"max\": %.3f, \"samples\": %u},\n",
+                     gpuStats.avgTime / 1e6, gpuStats.minTime / 1e6, gpuStats.maxTime / 1e6, gpuStats.samples);
+        std::fprintf(report,
+                     "  \"memory\": {\"deviceMemoryCount\": %u, \"reservedBytes\": %llu, \"usedBytes\": %llu}\n}\n",
+                     memoryStats.deviceMemoryCount, static_cast<unsigned long long>(memoryStats.total.reservedBytes),
+                     static_cast<unsigned long long>(memoryStats.total.usedBytes));
+        if (report != stdout)
+            std::fclose(report);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
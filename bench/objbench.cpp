@@ -0,0 +1,216 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../headers/objimport.h"
+
+namespace std
+{
+template <> struct hash<Cthovk::Vertex>
+{
+    size_t operator()(Cthovk::Vertex const &vertex) const
+    {
+        return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1);
+    }
+};
+} // namespace std
+
+struct ObjBenchOptions
+{
+    std::string input;   // empty generates a grid
+    uint32_t grid{1024}; // quads per side of the generated grid
+    uint32_t runs{3};    // the fastest run is reported
+    uint32_t threads{std::max(1u, std::thread::hardware_concurrency())};
+    std::string output; // empty writes the report to stdout
+};
+
+static void parseOptions(int argc, char **argv, ObjBenchOptions &options)
+{
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (i + 1 == argc)
+            throw std::runtime_error("missing value for " + option);
+        std::string value = argv[++i];
+        if (option == "--input")
+            options.input = value;
+        else if (option == "--grid")
+            options.grid = std::stoul(value);
+        else if (option == "--runs")
+            options.runs = std::stoul(value);
+        else if (option == "--threads")
+            options.threads = std::stoul(value);
+        else if (option == "--output")
+            options.output = value;
+        else
+            throw std::runtime_error("unknown option " + option);
+    }
+
+    if (options.grid == 0 || options.runs == 0 || options.threads == 0)
+        throw std::runtime_error("--grid, --runs and --threads need to be at least 1");
+}
+
+// the coloring of the mesh converter
+static glm::vec3 colorize(const glm::vec3 &pos)
+{
+    return {
+        std::abs(pos.y) * (std::abs(pos.x) + std::abs(pos.z)) + 0.2f,
+        0.0f,
+        std::abs(pos.y) * (std::abs(pos.z) + std::abs(pos.x)) + 0.2f,
+    };
+}
+
+// wavy grid of quads written with texture coordinates and normals like exporters do, every position is shared by
+// up to four faces
+static void writeGrid(const std::string &location, uint32_t grid)
+{
+    std::ofstream file(location, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + location);
+    for (uint32_t y{0}; y <= grid; ++y)
+    {
+        for (uint32_t x{0}; x <= grid; ++x)
+        {
+            float u = static_cast<float>(x) / grid;
+            float v = static_cast<float>(y) / grid;
+            file << "v " << u * 2.0f - 1.0f << ' ' << v * 2.0f - 1.0f << ' ' << 0.1f * std::sin(u * 20.0f) * v
+                 << "\nvt " << u << ' ' << v << "\nvn 0 0 1\n";
+        }
+    }
+    for (uint32_t y{0}; y < grid; ++y)
+    {
+        for (uint32_t x{0}; x < grid; ++x)
+        {
+            uint32_t corners[4]{y * (grid + 1) + x + 1, y * (grid + 1) + x + 2, (y + 1) * (grid + 1) + x + 2,
+                                (y + 1) * (grid + 1) + x + 1};
+            file << 'f';
+            for (uint32_t i{0}; i < 4; ++i)
+            {
+                file << ' ' << corners[i] << '/' << corners[i] << '/' << corners[i];
+            }
+            file << '\n';
+        }
+    }
+    if (!file.good())
+        throw std::runtime_error("failed to write " + location);
+}
+
+// the loader the mesh converter used before importObj, kept as the reference the import has to match
+static void loadModel(std::vector<Cthovk::Vertex> *vertices, std::vector<uint32_t> *indices, std::string path)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+        throw std::runtime_error(warn + err);
+
+    std::unordered_map<Cthovk::Vertex, uint32_t> uniqueVertices{};
+    for (uint32_t i{0}; i < shapes.size(); i++)
+    {
+        for (uint32_t j{0}; j < shapes[i].mesh.indices.size(); j++)
+        {
+            glm::vec3 pos{
+                attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index],
+                attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 1],
+                attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 2],
+            };
+            Cthovk::Vertex vertex{
+                .pos = pos,
+                .color = colorize(pos),
+            };
+
+            if (uniqueVertices.count(vertex) == 0)
+            {
+                uniqueVertices[vertex] = static_cast<uint32_t>(vertices->size());
+                vertices->push_back(vertex);
+            }
+            indices->push_back(uniqueVertices[vertex]);
+        }
+    }
+}
+
+static double milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    ObjBenchOptions options;
+    try
+    {
+        parseOptions(argc, argv, options);
+        std::string location = options.input;
+        if (location.empty())
+        {
+            location = "objbench.obj";
+            writeGrid(location, options.grid);
+        }
+
+        std::vector<Cthovk::Vertex> referenceVertices;
+        std::vector<uint32_t> referenceIndices;
+        double referenceMs{0.0};
+        for (uint32_t i{0}; i < options.runs; ++i)
+        {
+            referenceVertices.clear();
+            referenceIndices.clear();
+            auto start = std::chrono::steady_clock::now();
+            loadModel(&referenceVertices, &referenceIndices, location);
+            double time = milliseconds(start, std::chrono::steady_clock::now());
+            referenceMs = i == 0 ? time : std::min(referenceMs, time);
+        }
+
+        FILE *report = options.output.empty() ? stdout : std::fopen(options.output.c_str(), "w");
+        if (report == nullptr)
+            throw std::runtime_error("failed to open " + options.output);
+        std::fprintf(report, "{\n  \"input\": \"%s\",\n  \"vertices\": %zu,\n  \"indices\": %zu,\n", location.c_str(),
+                     referenceVertices.size(), referenceIndices.size());
+        std::fprintf(report, "  \"tinyobjMs\": %.3f,\n  \"importObj\": [", referenceMs);
+        // powers of two up to the requested count, and the count itself
+        bool identical{true};
+        for (uint32_t threads{1};; threads = std::min(2 * threads, options.threads))
+        {
+            Cthovk::WorkerPool workers(threads);
+            std::vector<Cthovk::Vertex> vertices;
+            std::vector<uint32_t> indices;
+            double time{0.0};
+            for (uint32_t i{0}; i < options.runs; ++i)
+            {
+                auto start = std::chrono::steady_clock::now();
+                Cthovk::importObj(location, workers, vertices, indices, colorize);
+                double run = milliseconds(start, std::chrono::steady_clock::now());
+                time = i == 0 ? run : std::min(time, run);
+            }
+            bool same = vertices == referenceVertices && indices == referenceIndices;
+            identical = identical && same;
+            std::fprintf(report, "%s\n    {\"threads\": %u, \"ms\": %.3f, \"speedup\": %.2f, \"identical\": %s}",
+                         threads == 1 ? "" : ",", threads, time, referenceMs / time, same ? "true" : "false");
+            if (threads == options.threads)
+                break;
+        }
+        std::fprintf(report, "\n  ]\n}\n");
+        if (report != stdout)
+            std::fclose(report);
+        if (!identical)
+        {
+            std::fprintf(stderr, "importObj differs from the tinyobjloader reference\n");
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
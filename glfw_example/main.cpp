@@ -1,70 +1,8 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 #include "../headers/application.h"
-
-namespace std
-{
-template <> struct hash<Cthovk::Vertex>
-{
-    size_t operator()(Cthovk::Vertex const &vertex) const
-    {
-        return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1);
-    }
-};
-} // namespace std
-
-void loadModel(std::vector<Cthovk::Vertex> *vertices, std::vector<uint32_t> *indices, std::string path)
-{
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
-        throw std::runtime_error(warn + err);
-
-    std::unordered_map<Cthovk::Vertex, uint32_t> uniqueVertices{};
-    for (uint32_t i{0}; i < shapes.size(); i++)
-    {
-        for (uint32_t j{0}; j < shapes[i].mesh.indices.size(); j++)
-        {
-            Cthovk::Vertex vertex{
-                .pos =
-                    {
-                        attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index],
-                        attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 1],
-                        attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 2],
-                    },
-                .color =
-                    {
-                        // random coloring function
-                        std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 1]) *
-                                (std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 0]) +
-                                 std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 2])) +
-                            0.2f,
-                        0.0f,
-                        std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 1]) *
-                                (std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 2]) +
-                                 std::abs(attrib.vertices[3 * shapes[i].mesh.indices[j].vertex_index + 0])) +
-                            0.2f,
-                    },
-            };
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices->size());
-                vertices->push_back(vertex);
-            }
-            if (indices != nullptr)
-                indices->push_back(uniqueVertices[vertex]);
-        }
-    }
-}
+#include "../headers/meshfile.h"
 
 class GLFW
 {
@@ -114,47 +52,44 @@ class GLFW
     };
 };
 
-int main()
+static glm::mat4 view()
 {
-    Cthovk::Model torus;
-    loadModel(&torus.verticesData, &torus.indicesData, "models/torus.obj");
+    return glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+}
 
-    Cthovk::Model torusZ(torus);
-    torusZ.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-    torusZ.updateUBO = [&](Cthovk::UniformBufferObject &ubo, Cthovk::SwapChainObj &sc) {
-        static auto startTime = std::chrono::high_resolution_clock::now();
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.01f, 100.0f);
-        ubo.proj[1][1] *= -1;
-    };
+static glm::mat4 projection(Cthovk::SwapChainObj &sc)
+{
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.01f, 100.0f);
+    proj[1][1] *= -1;
+    return proj;
+}
 
-    Cthovk::Model torusY(torus);
-    torusY.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    torusY.updateUBO = [&](Cthovk::UniformBufferObject &ubo, Cthovk::SwapChainObj &sc) {
+// spins an object around axis
+static std::function<void(Cthovk::UniformBufferObject &, Cthovk::SwapChainObj &)> spin(glm::vec3 axis)
+{
+    return [axis](Cthovk::UniformBufferObject &ubo, Cthovk::SwapChainObj &sc) {
         static auto startTime = std::chrono::high_resolution_clock::now();
         auto currentTime = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.01f, 100.0f);
-        ubo.proj[1][1] *= -1;
+        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), axis);
     };
+}
 
-    Cthovk::Model torusX(torus);
-    torusX.topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
-    torusX.updateUBO = [&](Cthovk::UniformBufferObject &ubo, Cthovk::SwapChainObj &sc) {
-        static auto startTime = std::chrono::high_resolution_clock::now();
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.01f, 100.0f);
-        ubo.proj[1][1] *= -1;
-    };
+// small copies of a mesh laid out on a ring around the origin, all of them drawn by one instanced draw
+static std::vector<Cthovk::InstanceData> ring(uint32_t count, float radius)
+{
+    std::vector<Cthovk::InstanceData> instances(count);
+    for (uint32_t i{0}; i < count; ++i)
+    {
+        float angle = glm::radians(360.0f) * i / count;
+        instances[i].model = glm::translate(glm::mat4(1.0f), radius * glm::vec3(std::cos(angle), std::sin(angle), 0.0f));
+        instances[i].model = glm::scale(instances[i].model, glm::vec3(0.05f));
+    }
+    return instances;
+}
 
+int main()
+{
     GLFW glfw(800, 800);
     Cthovk::DeviceInfo deviceInfo{
         .enableVL = true,
@@ -167,12 +102,46 @@ int main()
         .getFrameBufferSize = glfw.getFrameBufferSize,
         .vertShaderLocation = "shaders/shader.vert.spv",
         .fragShaderLocation = "shaders/shader.frag.spv",
+        .pipelineCacheLocation = "pipeline.cache",
         .multiSampleCount = VK_SAMPLE_COUNT_16_BIT,
         .framesInFlight = 2,
-        .models = {torusX, torusY, torusZ},
         .clearValue = {{{0.02f, 0.0f, 0.03f}}},
+        // follows the size of the window
+        .updateCamera =
+            [](Cthovk::CameraData &camera, Cthovk::SwapChainObj &sc) {
+                camera.view = view();
+                camera.proj = projection(sc);
+            },
+        .indirectDraw = true,
+        .indirectVertShaderLocation = "shaders/indirect.vert.spv",
+        .cullShaderLocation = "shaders/cull.comp.spv",
+        .gpuProfiler = true,
+        .cpuProfiler = true,
     };
     Cthovk::Application app(deviceInfo, graphicsInfo, glfw.terminateCheck);
+    Cthovk::Graphics &graphics = app.getGraphics();
+    // the torus in source order is shared by the line and point objects, the optimized one by the triangle ones,
+    // the files are unmapped afterwards
+    Cthovk::MeshHandle torus;
+    Cthovk::MeshHandle torusTriangles;
+    {
+        Cthovk::MeshFileObj file("models/torus.cmesh");
+        torus = graphics.addMesh(file);
+        Cthovk::MeshFileObj optimized("models/torus.opt.cmesh");
+        torusTriangles =
+            graphics.addMesh(optimized, Cthovk::VertexFormat::Float32, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    }
+    graphics.addObject(torus, VK_PRIMITIVE_TOPOLOGY_LINE_STRIP, spin(glm::vec3(1.0f, 0.0f, 0.0f)));
+    graphics.addObject(torusTriangles, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, spin(glm::vec3(0.0f, 1.0f, 0.0f)));
+    graphics.addObject(torus, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, spin(glm::vec3(0.0f, 0.0f, 1.0f)));
+    Cthovk::ObjectHandle orbit =
+        graphics.addObject(torusTriangles, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, spin(glm::vec3(0.0f, 0.0f, 1.0f)));
+    graphics.setInstances(orbit, ring(256, 1.5f));
+
+    const Cthovk::PipelineCacheStats &cacheStats = graphics.getPipelineCacheStats();
+    std::cout << "pipeline cache: " << (cacheStats.loaded ? "loaded " : "no valid cache, ") << cacheStats.loadedBytes
+              << " bytes, " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, " << cacheStats.unknown
+              << " without feedback, " << cacheStats.creationTime / 1000 << "us creating pipelines" << std::endl;
 
     try
     {
@@ -184,5 +153,17 @@ int main()
         return EXIT_FAILURE;
     }
 
+    std::vector<Cthovk::GpuScopeStats> gpuStats = graphics.getGpuStats();
+    for (uint32_t i{0}; i < gpuStats.size(); ++i)
+    {
+        std::cout << "gpu " << gpuStats[i].name << ": " << gpuStats[i].minTime / 1000 << "us min, "
+                  << gpuStats[i].avgTime / 1000 << "us avg, " << gpuStats[i].maxTime / 1000 << "us max" << std::endl;
+    }
+    Cthovk::CpuFrameStats frameStats = graphics.getCpuProfiler().getFrameStats();
+    std::cout << "frame time over " << frameStats.frames << " frames: " << frameStats.p50 / 1000 << "us p50, "
+              << frameStats.p99 / 1000 << "us p99, " << frameStats.p999 / 1000 << "us p99.9, "
+              << frameStats.maxTime / 1000 << "us max" << std::endl;
+    graphics.getCpuProfiler().writeTrace("frame_trace.json");
+
     return EXIT_SUCCESS;
 }
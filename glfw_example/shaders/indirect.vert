@@ -0,0 +1,30 @@
+#version 450
+
+struct ObjectData {
+    mat4 model;
+};
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+} camera;
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+layout(std430, set = 1, binding = 1) readonly buffer InstanceObjects {
+    uint instanceObjects[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in mat4 instanceModel;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    // gl_InstanceIndex includes firstInstance, it indexes every drawn instance of the frame
+    ObjectData object = objects[instanceObjects[gl_InstanceIndex]];
+    gl_Position = camera.proj * camera.view * object.model * instanceModel * vec4(inPosition, 1.0);
+    gl_PointSize = 2.5;
+    fragColor = inColor;
+}
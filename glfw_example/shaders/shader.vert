@@ -1,19 +1,21 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(set = 0, binding = 0) uniform Camera {
     mat4 view;
     mat4 proj;
+} camera;
+layout(set = 1, binding = 0) uniform UniformBufferObject {
+    mat4 model;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in mat4 instanceModel;
 
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = camera.proj * camera.view * ubo.model * instanceModel * vec4(inPosition, 1.0);
     gl_PointSize = 2.5;
     fragColor = inColor;
 }
-
@@ -9,14 +9,14 @@ class Application
 {
   public:
     void run();
+    Graphics &getGraphics();
 
-    Application(DeviceInfo deviceInfo, GraphicsInfo graphicsInfo, std::function<bool()> terminateCheck);
+    Application(DeviceInfo deviceInfo, const GraphicsInfo &graphicsInfo, std::function<bool()> terminateCheck);
     ~Application();
 
   private:
     std::function<bool()> terminateCheck;
     Device device;
     Graphics graphics;
-    GraphicsInfo grInfo;
 };
 } // namespace Cthovk
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Cthovk
+{
+
+struct CpuFrameStats
+{
+    uint64_t p50{0}; // nanoseconds between the starts of two frames, over the last CpuProfiler::window frames
+    uint64_t p99{0};
+    uint64_t p999{0};
+    uint64_t maxTime{0};
+    uint32_t frames{0};
+};
+
+// scoped CPU timers that stay compiled in, a disabled profiler costs one atomic load per scope
+//
+// every thread writes its events into a ring of its own without locking, the oldest events are overwritten once it is
+// full. names are not copied and have to outlive the profiler, string literals in practice
+class CpuProfiler
+{
+  public:
+    static constexpr uint32_t window{4096};
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    // 0 while disabled, end ignores it then
+    uint64_t begin() const;
+    void end(const char *name, uint64_t begin);
+    // called once at the start of every frame by the thread drawing, the previous frame becomes a "frame" event
+    void beginFrame();
+    // safe to call from any thread while the others keep recording
+    CpuFrameStats getFrameStats() const;
+    // the events still held by the rings as chrome://tracing / Perfetto json, one track per thread
+    void writeTrace(const std::string &location) const;
+
+    CpuProfiler(bool enabled, uint32_t eventsPerThread = 1u << 14);
+
+  private:
+    struct Event
+    {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> end{0};
+    };
+
+    // written by its thread only, readers copy it and drop what was overwritten meanwhile
+    struct ThreadRing
+    {
+        std::thread::id thread;
+        uint32_t index; // track in the trace
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t> written{0};
+    };
+
+    std::atomic<bool> enabled;
+    uint64_t id; // tells the thread local ring caches of profilers sharing an address apart
+    uint64_t origin;
+    uint32_t eventsPerThread;
+    mutable std::mutex mutex; // guards rings, only taken by the first event of a thread and by readers
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::unique_ptr<std::atomic<uint64_t>[]> frameTimes; // ring of the last window frames
+    std::atomic<uint64_t> frameCount{0};
+    uint64_t frameStart{0};
+
+    ThreadRing &ring();
+};
+
+// times the enclosing scope, does nothing without a profiler
+class CpuScope
+{
+  public:
+    CpuScope(CpuProfiler *profiler, const char *name);
+    ~CpuScope();
+    CpuScope(const CpuScope &) = delete;
+    CpuScope &operator=(const CpuScope &) = delete;
+
+  private:
+    CpuProfiler *profiler;
+    const char *name;
+    uint64_t start{0};
+};
+
+} // namespace Cthovk
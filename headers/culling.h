@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "graphics.h"
+
+namespace Cthovk
+{
+
+// frustum culls the indirect draws of a frame on the compute queue, the graphics submission of the frame waits on
+// the returned semaphore so on a separate compute queue culling overlaps the rendering of the previous frame
+//
+// draws of meshlets with a normal cone are also dropped once every one of their triangles faces away from the camera
+//
+// compacting writes the visible draws of every batch to its front and their number to the batch count, it needs
+// vkCmdDrawIndexedIndirectCount, otherwise every draw keeps its slot and culled ones get an instance count of 0
+struct CullObj
+{
+    struct PushConstants
+    {
+        uint32_t commandCount;
+        uint32_t compact;
+    };
+
+    VkDevice logDevice;
+    VkQueue queue;
+    VkCommandPool pool;
+    std::vector<VkCommandBuffer> commandBuffers; // per frame in flight
+    std::vector<VkSemaphore> semaphores;         // signaled once the culled draws of a frame are written
+    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<uint64_t> versions; // version of the indirect frame each command buffer was recorded for
+    DescriptorPoolObj descriptors;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    bool compact;
+
+    // points the descriptor set of the frame at the buffers of the indirect frame
+    void bind(uint32_t frame, const IndirectFrameObj &indirect);
+    // submits the culling of the frame, the semaphore has to be waited on before the culled draws are read
+    VkSemaphore cull(uint32_t frame, const IndirectFrameObj &indirect);
+
+    CullObj(VkDevice logDevice, uint32_t queueFamily, VkQueue queue, uint32_t framesInFlight,
+            std::string shaderLocation, PipelineCacheObj &cache, bool compact);
+    ~CullObj();
+};
+
+} // namespace Cthovk
@@ -20,6 +20,20 @@ struct QueueObj
     VkQueue graphics;
     VkQueue present;
     VkQueue compute;
+    VkQueue transfer; // same as graphics when the GPU has no transfer only family
+    uint32_t graphicsFamily;
+    uint32_t presentFamily;
+    uint32_t computeFamily;
+    uint32_t transferFamily;
+};
+
+// optional device extensions and features, enabled whenever the GPU supports them
+struct DeviceFeatures
+{
+    bool pipelineCreationFeedback{false};
+    bool drawIndirectCount{false};
+    bool multiDrawIndirect{false};
+    bool drawIndirectFirstInstance{false};
 };
 
 struct DeviceInfo
@@ -28,16 +42,18 @@ struct DeviceInfo
     std::vector<const char *> vl;
     std::vector<const char *> deviceExt;
     std::vector<const char *> windowExt;
+    // left empty the device is headless, no surface is created and no present support is required
     std::function<void(VkInstance instance, VkSurfaceKHR *surface)> initSurface;
 };
 
 class Device
 {
   public:
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface{VK_NULL_HANDLE};
     VkPhysicalDevice phyDevice{VK_NULL_HANDLE};
     VkDevice logDevice;
     QueueObj queues;
+    DeviceFeatures features;
 
     VkFormat findDepthFormat();
 
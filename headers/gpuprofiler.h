@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Cthovk
+{
+
+struct GpuScopeStats
+{
+    std::string name;
+    uint64_t minTime{0}; // nanoseconds per frame, over the last GpuProfiler::window resolved frames
+    uint64_t avgTime{0};
+    uint64_t maxTime{0};
+    uint32_t samples{0};
+};
+
+// timestamp queries around scopes of the recorded command buffers, every frame in flight has its own query pool
+// that is read once the fence of the frame signaled so resolving never stalls
+//
+// a command buffer resets its queries itself and remembers the scopes it wrote, it can be replayed unchanged
+class GpuProfiler
+{
+  public:
+    static constexpr uint32_t window{128};
+    static constexpr uint32_t NONE{UINT32_MAX};
+
+    // registering a name again returns the same scope
+    uint32_t scope(const std::string &name);
+    // called right after vkBeginCommandBuffer, buffer is recorded for frame and forgets the scopes it wrote before
+    void beginBuffer(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t frame);
+    // returns the interval to end, NONE once the query pool of the frame is full
+    uint32_t begin(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t scope);
+    void end(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t interval);
+    // buffer is submitted next for frame
+    void submit(uint32_t frame, uint32_t buffer);
+    // reads the queries of the last submission of frame, its fence has to be signaled already
+    void resolve(uint32_t frame);
+    std::vector<GpuScopeStats> getStats() const;
+    // forgets the frames resolved so far, the scopes stay registered
+    void resetStats();
+
+    // queueFamily runs the profiled command buffers, with a csvLocation every resolved frame appends one
+    // frame,scope,nanoseconds row per scope it wrote
+    GpuProfiler(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t queueFamily, uint32_t framesInFlight,
+                std::string csvLocation, uint32_t maxIntervals = 64);
+    ~GpuProfiler();
+
+  private:
+    struct Scope
+    {
+        std::string name;
+        std::vector<uint64_t> times; // ring of the last window frames
+        uint32_t next{0};
+        uint32_t samples{0};
+        uint64_t frameTime{0}; // summed over the intervals of the frame being resolved
+        bool written{false};
+    };
+
+    struct Recording
+    {
+        uint32_t frame{0};
+        std::vector<uint32_t> scopes; // scope of every interval, the queries 2 * interval and 2 * interval + 1
+    };
+
+    VkDevice logDevice;
+    std::vector<VkQueryPool> pools;    // per frame in flight
+    std::vector<uint32_t> submitted;   // per frame in flight, buffer of its last submission
+    std::vector<Recording> recordings; // per command buffer
+    std::vector<Scope> scopes;
+    std::vector<uint64_t> results;
+    double period;      // nanoseconds per tick
+    uint64_t validMask; // timestampValidBits of the queue family
+    uint32_t maxIntervals;
+    uint64_t resolvedFrames{0};
+    std::ofstream csv;
+};
+
+} // namespace Cthovk
@@ -6,15 +6,27 @@
 #include <cstring>
 #include <fstream>
 #include <functional>
+#include <limits>
+#include <numeric>
 #include <set>
 #include <vector>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
+#include "cpuprofiler.h"
+#include "device.h"
+#include "gpuprofiler.h"
+#include "memory.h"
+#include "pipelinecache.h"
+#include "transforms.h"
+#include "upload.h"
+#include "workers.h"
+
 namespace Cthovk
 {
 
@@ -28,68 +40,157 @@ struct ShaderObj
     ~ShaderObj();
 };
 
+struct ImageObj;
+
+// without a surface (headless) the images are a ring of offscreen color targets instead of a swapchain, sized once
+// by getFrameBufferSize, frames are handed to GraphicsInfo::frameReady in the order they were drawn and nothing
+// waits on vsync
 struct SwapChainObj
 {
-    VkSwapchainKHR SwapChain;
+    VkSwapchainKHR SwapChain{VK_NULL_HANDLE};
     VkFormat format;
     VkExtent2D extent;
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
+    std::vector<ImageObj *> offscreenImages; // own images and imageViews when headless
+    bool copySource{true}; // the images can be copied out of, only surfaces without transfer source usage clear it
     VkDevice logDevice;
 
+    // oldSwapChain is retired by the new one, it still has to be destroyed
     SwapChainObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkSurfaceKHR surface,
-                 std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize);
+                 std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize, MemoryAllocator &allocator,
+                 VkFormat offscreenFormat, uint32_t offscreenCount, VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+    SwapChainObj(const SwapChainObj &) = delete;
+    SwapChainObj &operator=(const SwapChainObj &) = delete;
+    SwapChainObj(SwapChainObj &&other);
+    SwapChainObj &operator=(SwapChainObj &&other);
     void initSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface,
-                       std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize);
+                       std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize,
+                       VkSwapchainKHR oldSwapChain);
     void initImageViews();
+    void initOffscreen(std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize,
+                       MemoryAllocator &allocator, VkFormat offscreenFormat, uint32_t offscreenCount);
     ~SwapChainObj();
+
+  private:
+    void destroy();
 };
 
 // Forward Declaration for CommandObj
 struct PipelineObj;
 struct BufferObj;
+struct MeshObj;
+struct MeshLod;
+struct SceneBatchObj;
+struct IndirectFrameObj;
+struct CullObj;
+struct ReadbackObj;
+struct MeshFileObj;
 
 struct CommandObj
 {
     VkCommandPool Pool;
-    std::vector<VkCommandBuffer> Buffers;
+    std::vector<VkCommandBuffer> Buffers; // [frame * images + image]
+    std::vector<uint64_t> versions; // scene version each buffer was recorded at, 0 when it must be recorded
     VkClearValue clearValue = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
     VkDevice logDevice;
-
-    CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t framesInFlight, VkClearValue clearValue);
+    uint32_t graphicsFamily;
+    uint32_t framesInFlight;
+    bool multiDrawIndirect{false};
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount{nullptr}; // set when the device supports it
+    // set while GPU timings are collected, the render pass and every group of draws sharing a pipeline are timed,
+    // draws recorded into secondaries only as part of the render pass
+    GpuProfiler *profiler{nullptr};
+    uint32_t renderPassScope{0}; // looked up once so recording never searches the scopes
+    CpuProfiler *cpuProfiler{nullptr}; // times the recording of every secondary
+    // with more than one thread the draws are split across secondaries recorded in parallel
+    uint32_t threadCount;
+    std::vector<VkCommandPool> threadPools;   // [frame * threadCount + thread]
+    std::vector<VkCommandBuffer> secondaries; // [buffer * threadCount + thread]
+
+    CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t framesInFlight, uint32_t images,
+               uint32_t threadCount, VkClearValue clearValue);
     ~CommandObj();
 
-    void record(std::vector<PipelineObj *> pipelines, std::vector<VkDescriptorSet> descriptorSet,
-                std::vector<BufferObj *> vertexBuf, std::vector<BufferObj *> indexBuf,
-                std::vector<VkPrimitiveTopology> topologies, VkRenderPass renderPass, VkFramebuffer frameBuffer,
-                SwapChainObj &sc, uint32_t currentcb);
+    // allocates buffers for every frame in flight and swapchain image and marks all of them for recording
+    void resize(uint32_t images);
+    // levelDraws holds the VkDrawIndexedIndirectCommand of every level of detail of every object at maxLods per
+    // object, their instance counts change without recording again
+    void record(const SceneBatchObj &objects, const std::vector<MeshObj> &meshes,
+                const std::vector<BufferObj *> &instanceBuffers, VkBuffer levelDraws, VkDescriptorSet cameraSet,
+                VkDescriptorSet descriptorSet, uint32_t uniformStride,
+                VkBuffer vertexBuffer, VkBuffer indexBuffer, VkRenderPass renderPass, VkFramebuffer frameBuffer,
+                SwapChainObj &sc, uint32_t currentcb, uint32_t frame);
+    // one indirect draw per pipeline, the cost no longer depends on the number of objects
+    void recordIndirect(const IndirectFrameObj &indirect, VkDescriptorSet cameraSet, VkBuffer vertexBuffer,
+                        VkBuffer indexBuffer, VkRenderPass renderPass, VkFramebuffer frameBuffer, SwapChainObj &sc,
+                        uint32_t currentcb, uint32_t frame);
+
+  private:
+    // what the recording tasks of the current record call draw
+    struct DrawList
+    {
+        const SceneBatchObj *objects;
+        const std::vector<MeshObj> *meshes;
+        const std::vector<BufferObj *> *instanceBuffers;
+        VkBuffer levelDraws;
+        VkDescriptorSet cameraSet;
+        VkDescriptorSet descriptorSet; // of the uniform ring of the frame, every object at its own dynamic offset
+        uint32_t uniformStride;
+        VkBuffer vertexBuffer;
+        VkBuffer indexBuffer;
+        VkRenderPass renderPass;
+        VkFramebuffer frameBuffer;
+        VkExtent2D extent;
+        uint32_t buffer;
+        uint32_t frame;
+    };
+
+    WorkerPool workers;
+    std::function<void(uint32_t task)> secondaryTask;
+    DrawList drawList;
+    uint32_t renderPassInterval{GpuProfiler::NONE};
+
+    void beginRenderPass(uint32_t currentcb, uint32_t frame, VkRenderPass renderPass, VkFramebuffer frameBuffer,
+                         VkExtent2D extent, VkSubpassContents contents);
+    void endRenderPass(uint32_t currentcb);
+    void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent);
+    void recordSecondary(uint32_t task);
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last);
 };
 
 struct BufferObj
 {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation memory;
     uint32_t Count; // optinal really
     VkDevice logDevice;
+    MemoryAllocator *allocator;
 
-    BufferObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize size, VkBufferUsageFlags usage,
-              VkMemoryPropertyFlags properties, uint32_t count = 0);
+    // the buffer is shared concurrently when more than one distinct queue family is given
+    BufferObj(VkDevice logDevice, MemoryAllocator &allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+              VkMemoryPropertyFlags properties, uint32_t count = 0, std::vector<uint32_t> queueFamilies = {});
+    BufferObj(BufferObj &&other);
     ~BufferObj();
 
-    static BufferObj optimizeForGPU(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize size,
-                                    const void *inputData, VkBufferUsageFlagBits usageBit, CommandObj &command,
-                                    VkQueue graphicsQueue, uint32_t count = 0);
+    // the copy is only recorded, it becomes visible to later submissions once upload is submitted
+    static BufferObj optimizeForGPU(VkDevice logDevice, MemoryAllocator &allocator, VkDeviceSize size,
+                                    const void *inputData, VkBufferUsageFlagBits usageBit, UploadBatchObj &upload,
+                                    uint32_t count = 0, uint64_t *ticket = nullptr);
 };
 
 struct ImageObj
 {
     VkImage image;
-    VkDeviceMemory memory;
+    Allocation memory;
     VkImageView view;
     VkDevice logDevice;
+    MemoryAllocator *allocator;
 
-    ImageObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkExtent2D extent, VkSampleCountFlagBits samples,
+    ImageObj(VkDevice logDevice, MemoryAllocator &allocator, VkExtent2D extent, VkSampleCountFlagBits samples,
              VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags imageAspectFlag);
+    ImageObj(ImageObj &&other);
+    ImageObj &operator=(ImageObj &&other);
     ~ImageObj();
 };
 
@@ -99,20 +200,35 @@ struct DescriptorPoolObj
     VkDescriptorSetLayout descriptorlayout;
     VkDevice logDevice;
 
-    DescriptorPoolObj(VkDevice logDevice, uint32_t modelSize, uint32_t fIF);
+    // every set has one binding per type, visible to the given stages
+    DescriptorPoolObj(VkDevice logDevice, uint32_t modelSize, uint32_t fIF,
+                      std::vector<VkDescriptorType> types = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER},
+                      VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT);
     ~DescriptorPoolObj();
 };
 
+// how the vertices of a mesh are stored on the GPU, meshes of every format get pipelines of their own
+enum class VertexFormat : uint32_t
+{
+    Float32, // Vertex as it is, 24 bytes
+    Half,    // half float positions and 8 bit colors, 12 bytes
+    Snorm16, // positions quantized to the bounding box of the mesh and 8 bit colors, 12 bytes
+};
+
 struct PipelineObj
 {
     VkPipelineLayout layout;
     VkPipeline pl;
     VkPrimitiveTopology topology;
+    VertexFormat format;
+    uint32_t profilerScope{0}; // GPU profiler scope of its draws, set when the pipeline is added while profiling
     VkDevice logDevice;
 
-    PipelineObj(VkDevice logDevice, VkRenderPass renderPass, DescriptorPoolObj &pool, SwapChainObj &sc,
-                std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos, VkSampleCountFlagBits multi,
-                VkPrimitiveTopology topology);
+    // the camera is bound to set 0 and the objects to set 1
+    PipelineObj(VkDevice logDevice, VkRenderPass renderPass, DescriptorPoolObj &cameraPool, DescriptorPoolObj &pool,
+                SwapChainObj &sc, std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos,
+                VkSampleCountFlagBits multi, VkPrimitiveTopology topology, VertexFormat format,
+                VkCullModeFlags cullMode, PipelineCacheObj &cache);
 
     ~PipelineObj();
 };
@@ -162,13 +278,231 @@ struct Vertex
     }
 };
 
+// Vertex packed for VertexFormat::Half and VertexFormat::Snorm16, the fourth position component is padding
+struct CompactVertex
+{
+    uint16_t pos[4];
+    uint32_t color; // R8G8B8A8_UNORM, alpha is 1
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributes(VertexFormat format)
+    {
+        return {
+            {
+                .location = 0,
+                .binding = 0,
+                .format =
+                    format == VertexFormat::Half ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM,
+                .offset = offsetof(CompactVertex, pos),
+            },
+            {
+                .location = 1,
+                .binding = 0,
+                .format = VK_FORMAT_R8G8B8A8_UNORM,
+                .offset = offsetof(CompactVertex, color),
+            },
+        };
+    }
+};
+static_assert(sizeof(CompactVertex) == 12, "CompactVertex is uploaded as is");
+
+// per instance vertex data, read from binding 1 and applied after the object's model matrix
+struct InstanceData
+{
+    glm::mat4 model{1.0f};
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributes()
+    {
+        // a mat4 takes one location per column
+        std::vector<VkVertexInputAttributeDescription> instanceAttributes(4);
+        for (uint32_t i{0}; i < instanceAttributes.size(); ++i)
+        {
+            instanceAttributes[i] = {
+                .location = 2 + i,
+                .binding = 1,
+                .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                .offset = static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * i),
+            };
+        }
+        return instanceAttributes;
+    };
+};
+
+// per object data, read from set 1
 struct UniformBufferObject
 {
     glm::mat4 model;
+};
+
+// the point of view of a frame, shared by every object and read from set 0
+struct CameraData
+{
     glm::mat4 view;
     glm::mat4 proj;
 };
 
+// a cluster of neighbouring triangles of a mesh, drawn and culled on its own as a range of the mesh's indices
+struct Meshlet
+{
+    uint32_t firstIndex; // from the first index of the mesh
+    uint32_t indexCount;
+    glm::vec4 sphere; // bounding sphere, center and radius
+    // the normals of all triangles lie within this cone, axis and sine of the half angle, 1 never faces away
+    glm::vec4 cone;
+};
+
+// a simplified version of a mesh drawing the same vertices with fewer triangles
+struct MeshLod
+{
+    uint32_t firstIndex; // from the first index of the mesh
+    uint32_t indexCount;
+    float error; // the errors of simplifyMesh for every level up to this one added up, in the units of the positions
+};
+
+typedef uint32_t MeshHandle;
+static const uint32_t maxLods{8}; // levels of detail of a mesh including the mesh itself
+// meshes added without a topology can be drawn with every topology and are uploaded as they are
+static const VkPrimitiveTopology anyTopology{VK_PRIMITIVE_TOPOLOGY_MAX_ENUM};
+typedef uint32_t ObjectHandle;
+
+// geometry on the GPU, a range of the shared vertex and index buffers registered once and shared by every object
+// drawing it
+struct MeshObj
+{
+    int32_t vertexOffset; // in vertices of format
+    uint32_t firstIndex;  // in indices of indexType
+    uint32_t indexCount;
+    glm::vec4 bounds; // bounding sphere, center and radius
+    VertexFormat format;
+    VkIndexType indexType; // 16 bit for meshes of up to 65536 vertices
+    VkPrimitiveTopology topology; // the only one its objects are drawn with, anyTopology for every one
+    // maps the stored positions back onto the mesh, applied before the instance matrices, identity unless the
+    // positions are VertexFormat::Snorm16
+    glm::mat4 dequantize;
+    uint32_t firstMeshlet; // in Graphics::meshlets
+    uint32_t meshletCount; // 0 draws the mesh whole, triangle list objects draw every meshlet instead
+    uint32_t firstLod;     // in Graphics::lods, the first one is the mesh itself
+    uint32_t lodCount;     // levels from finest to coarsest, only triangle list objects draw the coarser ones
+    uint64_t uploadTicket;
+    bool ready{false}; // set once the upload was handed off to the graphics queue
+};
+
+// what a renderable only reads once it changes or when its flags ask for it, kept out of the arrays every frame walks
+struct SceneObjData
+{
+    std::function<void(UniformBufferObject &ubo, SwapChainObj &sc)> updateUBO; // optional, called every frame
+    std::vector<InstanceData> instances; // all of them are drawn with a single instanced draw
+    // with levels of detail the instances are drawn grouped by level, lodOrder lists them level after level, empty
+    // for objects drawing every instance at full detail
+    std::vector<uint32_t> lodOrder;
+    std::vector<uint8_t> instanceLods; // level every instance was drawn at last
+};
+
+// renderables stored field by field and indexed by ObjectHandle, the passes of every frame walk the hot arrays and
+// only reach into cold for the objects whose flags ask for it, the transforms written every frame are kept component
+// by component in TransformBatchObj
+struct SceneBatchObj
+{
+    static constexpr uint8_t TRANSFORMED{1};  // the model matrix comes from Graphics::setTransform instead of ubos
+    static constexpr uint8_t UPDATES_UBO{2};  // cold holds an updateUBO
+    static constexpr uint8_t SELECTS_LODS{4}; // the levels of detail of the instances are picked every frame
+
+    std::vector<MeshHandle> meshes;
+    std::vector<PipelineObj *> pipelines; // nullptr marks a removed object, its slot is reused by the next addObject
+    std::vector<glm::vec4> bounds;        // sphere around every instance, in the space of the object
+    std::vector<uint32_t> instanceCounts;
+    std::vector<uint32_t> lodInstances; // [maxLods * object + level], instances drawn at every level of detail
+    std::vector<uint32_t> staleFrames;  // frames in flight still drawing older instances or levels of detail
+    std::vector<uint8_t> flags;
+    std::vector<UniformBufferObject> ubos;
+    std::vector<SceneObjData> cold;
+
+    uint32_t size() const;
+    // appends a removed slot
+    ObjectHandle push();
+};
+
+// draws of one pipeline, consecutive in the indirect command buffer
+struct IndirectBatch
+{
+    PipelineObj *pipeline;
+    VkIndexType indexType;
+    uint32_t firstCommand;
+    uint32_t commandCount;
+};
+
+// fixed range of an object in the indirect buffers, one command per meshlet and coarser level of detail
+struct IndirectSlot
+{
+    uint32_t batch;
+    uint32_t firstCommand;
+    uint32_t firstInstance;
+    uint32_t instanceCapacity; // instances the range holds, setInstances moves the object once it needs more
+};
+
+// commands of a batch no object draws from, the ones of a removed object are cleared by every frame in flight once
+struct IndirectRange
+{
+    uint32_t batch;
+    uint32_t first;
+    uint32_t count;
+    uint32_t staleFrames; // frames in flight that still draw the removed object
+};
+
+// bounding sphere of one indirect draw before the model matrix of its object, covering all of its instances
+struct DrawBounds
+{
+    glm::vec4 sphere;
+    glm::vec4 cone; // normal cone of a meshlet drawn with a single instance, a cutoff of 1 skips the cone test
+    uint32_t object;
+    uint32_t batch;
+    uint32_t firstCommand; // of the batch
+    uint32_t padding;
+};
+
+// what a frame in flight draws from with GraphicsInfo::indirectDraw, objects added, removed or changed are patched
+// into their ranges in place and the draws are only written whole after a new layout
+struct IndirectFrameObj
+{
+    BufferObj *commands;        // VkDrawIndexedIndirectCommand of every drawn object or meshlet, grouped by pipeline
+    BufferObj *counts;          // command count of every batch
+    BufferObj *objectData;      // UniformBufferObject of every object slot, written every frame
+    BufferObj *camera;          // CameraData of the frame, owned by Graphics
+    BufferObj *instances;       // InstanceData of every drawn instance, Count holds the capacity
+    BufferObj *instanceObjects; // object slot of every drawn instance
+    // replace instances and instanceObjects once the fence of the frame was waited on
+    BufferObj *grownInstances{nullptr};
+    BufferObj *grownInstanceObjects{nullptr};
+    BufferObj *bounds{nullptr}; // DrawBounds of every command, the rest is only set with culling
+    BufferObj *culledCommands{nullptr};
+    BufferObj *culledCounts{nullptr};
+    VkDescriptorSet descriptorSet;
+    std::vector<IndirectBatch> batches;
+    uint32_t commandCount{0};
+    uint64_t version{0}; // scene version the draws were built at
+};
+
+// a finished headless frame in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, the image is not written again before the next
+// Graphics::draw call
+struct OffscreenFrame
+{
+    VkImage image;
+    VkImageView view;
+    VkFormat format;
+    VkExtent2D extent;
+    uint64_t number; // 1 for the first frame drawn, 0 while no frame is pending
+};
+
+// pixels of a frame read back to host memory with tightly packed rows, only valid until the callback returns
+struct ReadbackFrame
+{
+    const void *data;
+    VkDeviceSize size;
+    VkFormat format;
+    VkExtent2D extent;
+    uint64_t number;  // same numbering as OffscreenFrame
+    uint64_t dropped; // frames skipped so far because the consumer still held every slot
+};
+
 struct Model
 {
     std::vector<Vertex> verticesData{};
@@ -184,47 +518,206 @@ struct GraphicsInfo
     std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize;
     std::string vertShaderLocation;
     std::string fragShaderLocation;
+    std::string pipelineCacheLocation; // empty keeps the pipeline cache in memory only
     VkSampleCountFlagBits multiSampleCount;
     uint32_t framesInFlight;
     std::vector<Model> models;
     VkClearValue clearValue;
+    CameraData camera{glm::mat4(1.0f), glm::mat4(1.0f)};
+    std::function<void(CameraData &camera, SwapChainObj &sc)> updateCamera; // optional, called once every frame
+    // optional, called once every frame before the model matrices of the objects given a transform are built from
+    // it, a batch of many moving objects costs far less here than in updateUBO
+    std::function<void(TransformBatchObj &transforms, SwapChainObj &sc)> updateTransforms;
+    uint32_t transformThreads{1}; // more than one builds the model matrices on a worker pool
+    VkDeviceSize stagingBufferSize{64ull << 20};
+    uint32_t maxObjects{1024};
+    uint32_t maxDraws{1u << 16}; // with indirectDraw, objects take one draw and objects split into meshlets one each
+    // capacities of the buffers shared by all meshes, compact vertices and 16 bit indices take half the space
+    uint32_t maxVertices{1u << 20}; // in Vertex
+    uint32_t maxIndices{1u << 22};  // in uint32_t
+    // reorders meshes added from vectors as triangle lists for the vertex cache, overdraw and vertex fetch before
+    // they are uploaded, converted mesh files are optimized by the converter instead
+    bool optimizeMeshes{false};
+    bool reuseCommandBuffers{true}; // rerecord command buffers only when the scene changed
+    uint32_t recordThreads{1};      // more than one records secondary command buffers on a worker pool
+    // draw with one indirect draw per pipeline, needs drawIndirectFirstInstance and a vertex shader reading the
+    // objects from storage buffers, falls back to vertShaderLocation and direct draws without the feature
+    bool indirectDraw{false};
+    std::string indirectVertShaderLocation;
+    std::string cullShaderLocation; // with indirectDraw, frustum culls every object on the compute queue
+    bool splitMeshlets{false};    // with culling, culls triangle list meshes meshlet by meshlet, off by default
+    std::vector<float> lodRatios; // triangle fractions of the coarser levels of detail, empty draws full detail only
+    float lodErrorPixels{1.0f};   // screen error in pixels a level of detail may cover
+    float lodHysteresis{0.0f};    // fraction of lodErrorPixels a level has to undercut to get coarser, 0 for none
+    bool backFaceCulling{false};  // drops back faces and meshlets facing away, off by default
+    VkFormat offscreenFormat{VK_FORMAT_R8G8B8A8_UNORM};          // of the images drawn into without a surface
+    std::function<void(const OffscreenFrame &frame)> frameReady; // optional, gets every headless frame in order
+    uint32_t readbackFrames{0}; // host buffers frames are copied into, 0 reads nothing back
+    std::function<void(const ReadbackFrame &frame)> frameReadback; // called on a thread of its own, see ReadbackObj
+    bool gpuProfiler{false};        // timestamps every frame, see Graphics::getGpuStats
+    std::string gpuProfileLocation; // with gpuProfiler, the time of every scope and frame is written here as csv
+    bool cpuProfiler{false};        // starts the phase timers of every frame enabled, see Graphics::getCpuProfiler
 };
 
 class Graphics
 {
   public:
     Graphics(VkDevice logDevice, VkPhysicalDevice phyDevice, VkSurfaceKHR surface, VkFormat depthFormat,
-             VkQueue graphicsQueue, GraphicsInfo inf);
+             const QueueObj &queues, const DeviceFeatures &features, const GraphicsInfo &inf);
     ~Graphics();
 
-    void draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsInfo inf, VkQueue graphicsQueue,
-              VkQueue presentQueue);
+    // the geometry is copied into the staging ring right away, the vectors can be released once this returns,
+    // meshes of up to 65536 vertices get 16 bit indices
+    //
+    // a mesh added with a topology is only drawn with that one, its vertices and indices may be reordered for it,
+    // with anyTopology they are uploaded as they are
+    MeshHandle addMesh(const std::vector<Vertex> &verticesData, const std::vector<uint32_t> &indicesData,
+                       VertexFormat format = VertexFormat::Float32, VkPrimitiveTopology topology = anyTopology);
+    // copies straight from the mapping for VertexFormat::Float32, the bounds come from the file and the vertices
+    // are read only once, files written with MeshFileHeader::TRIANGLE_ORDER take VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+    MeshHandle addMesh(const MeshFileObj &mesh, VertexFormat format = VertexFormat::Float32,
+                       VkPrimitiveTopology topology = anyTopology);
+    // objects are drawn from the first frame after their mesh finished uploading
+    //
+    // with indirectDraw adding and removing an object only writes its own range of every frame in flight, until a
+    // batch runs out of free commands or the instances out of room and every object is laid out again, direct draws
+    // record every command buffer again
+    ObjectHandle addObject(MeshHandle mesh, VkPrimitiveTopology topology,
+                           std::function<void(UniformBufferObject &ubo, SwapChainObj &sc)> updateUBO = nullptr);
+    void removeObject(ObjectHandle object);
+    void setUBO(ObjectHandle object, const UniformBufferObject &ubo);
+    void setCamera(const CameraData &camera);
+    // from now on the model matrix of the object is built from this transform every frame and its updateUBO only
+    // runs for the rest of the ubo, the transform of the object is the slot of the same index in getTransforms
+    void setTransform(ObjectHandle object, glm::vec3 translation, glm::quat rotation, glm::vec3 scale);
+    // the transform of object becomes relative to the one of parent, noParent makes it relative to the world again,
+    // both objects are drawn from their transforms from then on, removing an object detaches its children
+    void setParent(ObjectHandle object, ObjectHandle parent);
+    TransformBatchObj &getTransforms();
+    // replaces the instances of an object, every object starts out with a single identity instance, costs the same
+    // as addObject
+    void setInstances(ObjectHandle object, const std::vector<InstanceData> &instances);
+    void draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, VkQueue graphicsQueue, VkQueue presentQueue);
+    // waits for every frame still in flight and hands the headless ones to GraphicsInfo::frameReady
+    void flushFrames();
+    // blocks until every mesh added so far finished uploading, the next draw draws all of them
+    void waitUploads();
+    MemoryStats getMemoryStats();
+    // rolling GPU times per scope, empty unless GraphicsInfo::gpuProfiler is set
+    std::vector<GpuScopeStats> getGpuStats();
+    void resetGpuStats();
+    // frame phase timers, can be toggled, summarized and exported while frames are drawn
+    CpuProfiler &getCpuProfiler();
+    const PipelineCacheStats &getPipelineCacheStats();
+    // triangles of every triangle list draw of the last frame, before culling
+    uint64_t getSubmittedTriangles();
 
   private:
     VkDevice logDevice;
+    bool indirectDraw;
+    bool optimizeMeshes;
+    bool splitMeshlets;
+    bool backFaceCulling;
+    bool headless; // no surface, frames go to offscreen images and are never presented
+    MemoryAllocator allocator;
     SwapChainObj sc;
-    std::vector<ShaderObj> shaders;
+    std::vector<ShaderObj *> shaders;
     VkRenderPass renderPass;
     CommandObj command;
-    std::vector<BufferObj *> vertices;
-    std::vector<BufferObj *> indices;
-    std::vector<BufferObj *> pUniforms;
-    std::vector<void *> uniformMemoryPointers;
+    UploadBatchObj upload;
+    PipelineCacheObj pipelineCache;
+    BufferObj vertexBuffer; // Count holds the capacity in Vertex
+    BufferObj indexBuffer;  // Count holds the capacity in uint32_t
+    VkDeviceSize vertexBytes{0};
+    VkDeviceSize indexBytes{0};
+    std::vector<MeshObj> meshes;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
+    std::vector<float> lodRatios;
+    float lodErrorPixels;
+    float lodHysteresis;
+    uint64_t submittedTriangles{0};
+    SceneBatchObj objects;
+    std::vector<ObjectHandle> freeObjects;
+    // [frame], the UniformBufferObject of every object slot at uniformStride, bound with dynamic offsets
+    std::vector<BufferObj *> uniformRings;
+    uint32_t uniformStride{0};
+    // [frame + framesInFlight * object], Count holds the capacity, every level of detail of the object has a region
+    // of the instance count
+    std::vector<BufferObj *> pInstances;
+    std::vector<BufferObj *> levelDraws; // [frame], see CommandObj::record
+    // [frame], buffers replaced while the frame was in flight, deleted once draw waited on its fence
+    std::vector<std::vector<BufferObj *>> retiredBuffers;
     ImageObj depth;
     ImageObj color;
     DescriptorPoolObj pool;
+    DescriptorPoolObj cameraPool;
+    std::vector<BufferObj *> cameraBuffers; // [frame]
+    std::vector<VkDescriptorSet> cameraSets; // [frame]
+    CameraData camera;
+    std::function<void(CameraData &camera, SwapChainObj &sc)> updateCamera;
+    TransformBatchObj transforms; // [object]
+    std::function<void(TransformBatchObj &transforms, SwapChainObj &sc)> updateTransforms;
+    uint32_t transformedObjects{0};
+    std::vector<glm::mat4> worldMatrices; // [object], only written while some transform has a parent
+    WorkerPool transformWorkers;
+    std::function<void(uint32_t task)> transformTask;
+    void *transformDestination{nullptr}; // of the running transformTask
+    size_t transformStride{0};
     std::vector<PipelineObj *> pipelines;
-    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<VkDescriptorSet> descriptorSets; // [frame]
+    std::vector<IndirectFrameObj> indirectFrames;
+    std::vector<IndirectBatch> indirectBatches; // copied into every frame written after the layout
+    std::vector<IndirectSlot> indirectSlots;    // [object]
+    std::vector<IndirectRange> freeCommands;
+    uint32_t indirectCommands{0};    // laid out, free ones included
+    uint32_t indirectInstanceEnd{0}; // first instance no object range holds
+    uint32_t indirectInstances{0}; // of every object in the scene
+    uint32_t instanceCapacity{0};  // of the instance buffers of the indirect frames once they grew
+    CullObj *culling{nullptr};
+    ReadbackObj *readback{nullptr};
+    GpuProfiler *profiler{nullptr};
+    CpuProfiler cpuProfiler;
     std::vector<VkFramebuffer> frameBuffers;
     SyncObj sync;
-    uint32_t currentFrame;
+    std::vector<OffscreenFrame> offscreenFrames; // [frame in flight], headless frame its last submission drew
+    std::function<void(const OffscreenFrame &frame)> frameReady;
+    uint64_t frameNumber{0};
+    uint32_t currentFrame{0};
     bool reinitSC{false};
     VkFormat depthFormat;
-
+    std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize;
+    VkSampleCountFlagBits multiSampleCount;
+    uint32_t framesInFlight;
+    uint32_t maxObjects;
+    uint32_t maxDraws;
+    uint32_t drawCount{0}; // indirect draws of every object in the scene
+    uint32_t pendingMeshes{0}; // meshes whose upload is not usable yet
+    bool reuseCommandBuffers;
+    uint64_t sceneVersion{1}; // bumped by every change that invalidates recorded command buffers
+
+    MeshHandle addMesh(const Vertex *verticesData, uint32_t meshVertexCount, const uint32_t *indicesData,
+                       uint32_t meshIndexCount, glm::vec4 bounds, VertexFormat format, VkPrimitiveTopology topology);
     void initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSampleCount, VkFormat depthFormat);
-    void initDescriptorSets(VkDevice logDevice, uint32_t modelCount, uint32_t fIF);
+    void resetLods(ObjectHandle object);
+    bool selectLods(ObjectHandle object, const glm::mat4 &objectModel);
+    void markTransformed(ObjectHandle object);
+    glm::mat4 objectModel(ObjectHandle object);
+    void initCamera(const QueueObj &queues);
+    void initUniformRings(VkPhysicalDevice phyDevice);
+    void initIndirectFrames(const QueueObj &queues);
+    void writeIndirectDescriptors(uint32_t frame);
+    void reserveInstances(uint32_t instanceCount);
+    void updateIndirectFrame(uint32_t frame);
+    void growInstanceBuffers(ObjectHandle object);
+    void writeDirectObject(uint32_t frame, ObjectHandle object);
+    bool allocateInstances(ObjectHandle object, uint32_t instanceCount);
+    void placeIndirectObject(ObjectHandle object);
+    void layoutIndirectDraws();
+    void writeIndirectObject(IndirectFrameObj &indirect, ObjectHandle object);
     void initFrameBuffers(VkDevice logDevice, VkSampleCountFlagBits multiSampleCount);
-    void reinitSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsInfo inf);
+    void reinitSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface);
+    void retireOffscreenFrame(uint32_t frame);
 };
 
 } // namespace Cthovk
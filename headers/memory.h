@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Cthovk
+{
+
+struct MemoryBlock;
+
+// a sub-range of a VkDeviceMemory block handed out by the MemoryAllocator
+struct Allocation
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    void *mapped{nullptr}; // only set for HOST_VISIBLE memory, already offset
+    uint32_t memoryType{UINT32_MAX};
+    MemoryBlock *block{nullptr}; // nullptr for dedicated allocations
+    uint32_t chunk{UINT32_MAX};
+};
+
+struct MemoryHeapStats
+{
+    uint32_t blockCount{0};
+    uint32_t dedicatedCount{0};
+    uint32_t allocationCount{0};
+    VkDeviceSize reservedBytes{0};
+    VkDeviceSize usedBytes{0};
+};
+
+struct MemoryStats
+{
+    uint32_t deviceMemoryCount{0}; // live vkAllocateMemory objects, bounded by maxMemoryAllocationCount
+    uint32_t maxDeviceMemoryCount{0};
+    MemoryHeapStats total;
+    std::vector<MemoryHeapStats> heaps;
+};
+
+// TLSF (two level segregated fit) free list over one VkDeviceMemory block
+struct MemoryBlock
+{
+    static constexpr uint32_t SL_BITS{5};
+    static constexpr uint32_t SL_COUNT{1 << SL_BITS};
+    static constexpr uint32_t FL_COUNT{64 - SL_BITS + 1};
+    static constexpr uint32_t NONE{UINT32_MAX};
+
+    struct Chunk
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t prevPhys{NONE};
+        uint32_t nextPhys{NONE};
+        uint32_t prevFree{NONE};
+        uint32_t nextFree{NONE};
+        bool free{false};
+    };
+
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    void *mapped{nullptr};
+    uint32_t memoryType{0};
+    uint32_t allocationCount{0};
+    VkDeviceSize usedBytes{0};
+
+    std::vector<Chunk> chunks;
+    std::vector<uint32_t> unusedChunks;
+    uint64_t flBitmap{0};
+    uint32_t slBitmap[FL_COUNT]{};
+    uint32_t freeHeads[FL_COUNT][SL_COUNT];
+
+    MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void *mapped, uint32_t memoryType);
+
+    bool allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &chunk);
+    void free(uint32_t chunk);
+
+  private:
+    uint32_t newChunk(VkDeviceSize offset, VkDeviceSize chunkSize);
+    void insertFree(uint32_t chunk);
+    void removeFree(uint32_t chunk);
+    uint32_t findFree(VkDeviceSize minSize);
+    void split(uint32_t chunk, VkDeviceSize firstSize);
+};
+
+// hands out aligned sub-ranges of large per memory type blocks instead of one vkAllocateMemory per resource
+class MemoryAllocator
+{
+  public:
+    // linear is true for buffers and linear images, false for optimal tiling images
+    Allocation allocate(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear);
+    void free(Allocation &allocation);
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+    MemoryStats getStats();
+
+    MemoryAllocator(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize preferredBlockSize = 64ull << 20);
+    ~MemoryAllocator();
+
+  private:
+    VkDevice logDevice;
+    VkPhysicalDeviceMemoryProperties memProperties;
+    VkDeviceSize bufferImageGranularity;
+    uint32_t maxDeviceMemoryCount;
+    uint32_t deviceMemoryCount{0};
+    std::vector<VkDeviceSize> blockSizes; // per memory heap
+    // pools are indexed by memoryType * 2 + linear, buffers and images never share a block when the
+    // bufferImageGranularity requires them to be kept apart
+    std::vector<std::vector<MemoryBlock *>> pools;
+    std::vector<MemoryHeapStats> dedicated; // per memory heap
+    std::mutex mutex;
+
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped);
+    void freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType);
+};
+
+} // namespace Cthovk
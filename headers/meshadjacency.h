@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Cthovk
+{
+
+// triangles of every vertex of a triangle list, laid out one vertex after the other, the ones of vertex v are
+// triangles[offsets[v]] up to triangles[offsets[v + 1]]
+struct TriangleAdjacencyObj
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    // keeps the memory of an earlier build
+    void build(const uint32_t *indices, uint32_t indexCount, uint32_t vertexCount);
+    uint32_t count(uint32_t vertex) const
+    {
+        return offsets[vertex + 1] - offsets[vertex];
+    }
+};
+
+} // namespace Cthovk
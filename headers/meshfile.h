@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graphics.h"
+
+namespace Cthovk
+{
+
+struct MeshBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec4 sphere; // center and radius, the center is the one of the box
+};
+
+MeshBounds computeBounds(const Vertex *vertices, uint32_t vertexCount);
+
+// start of a mesh file, the vertex and index blobs follow at multiples of ALIGNMENT so they can be used in place
+// from a mapping, written in the byte order of the machine converting it
+struct MeshFileHeader
+{
+    static constexpr uint32_t MAGIC{0x4d485443}; // "CTHM"
+    static constexpr uint32_t VERSION{2};
+    static constexpr uint32_t ALIGNMENT{64};
+    static constexpr uint32_t TRIANGLE_ORDER{1}; // flag of files reordered to be drawn as triangle lists only
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride; // sizeof(Vertex) of the converter, files of another layout are rejected
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t flags;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec4 sphere;
+};
+static_assert(sizeof(MeshFileHeader) == 80, "MeshFileHeader is stored as is");
+
+// every mesh is drawn indexed, one without indices (indexCount of 0) gets sequential ones written
+void writeMeshFile(const std::string &location, const Vertex *vertices, uint32_t vertexCount,
+                   const uint32_t *indices, uint32_t indexCount, uint32_t flags = 0);
+
+// read only mapping of a mesh file, the pages are read as the blobs are copied into the staging ring
+struct MeshFileObj
+{
+    MeshFileHeader header;
+    const Vertex *vertices;
+    const uint32_t *indices;
+
+    // throws when the file is truncated, was written for another Vertex layout or indexes past its vertices
+    MeshFileObj(const std::string &location);
+    MeshFileObj(const MeshFileObj &) = delete;
+    MeshFileObj &operator=(const MeshFileObj &) = delete;
+    ~MeshFileObj();
+
+  private:
+    void *mapping{MAP_FAILED};
+    size_t size{0};
+};
+
+} // namespace Cthovk
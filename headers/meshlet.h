@@ -0,0 +1,21 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "graphics.h"
+#include "meshadjacency.h"
+
+namespace Cthovk
+{
+
+// regroups the triangles of a triangle list into meshlets of up to maxVertices distinct vertices and maxTriangles
+// triangles, every meshlet grows from its first triangle over the ones adding the fewest new vertices, the indices
+// are reordered so the triangles of each meshlet are consecutive
+std::vector<Meshlet> buildMeshlets(const Vertex *vertices, uint32_t vertexCount, std::vector<uint32_t> &indices,
+                                   uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+} // namespace Cthovk
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "graphics.h"
+#include "meshadjacency.h"
+
+namespace Cthovk
+{
+
+// post-transform cache behaviour of an index buffer drawn as a triangle list through a fifo of cacheSize vertices
+struct VertexCacheStats
+{
+    float acmr; // transformed vertices per triangle, 0.5 is ideal for a regular grid and 3 the worst
+    float atvr; // transformed vertices per referenced vertex, 1 is ideal
+};
+
+struct MeshOptimizeStats
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, uint32_t vertexCount,
+                                    uint32_t cacheSize = 16);
+
+// reorders the triangles with tipsify, returns the first triangle of every cluster the cache starts cold at
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount,
+                                          uint32_t cacheSize = 16);
+
+// sorts the clusters of optimizeVertexCache so the ones facing away from the center of the mesh come first and
+// cover what is behind them, clusters are split further as long as the acmr of each stays within threshold times
+// the one of the cluster it came from
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices,
+                      const std::vector<uint32_t> &clusters, float threshold = 1.05f, uint32_t cacheSize = 16);
+
+// orders the vertices by their first use in the index buffer and drops the ones never used
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+// every stage above in order, triangle lists only, other index counts are left as they are
+MeshOptimizeStats optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices,
+                               uint32_t cacheSize = 16);
+
+} // namespace Cthovk
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "graphics.h"
+#include "meshadjacency.h"
+
+namespace Cthovk
+{
+
+// collapses edges of a triangle list in order of their quadric error until at most targetIndexCount indices are left
+// or every edge left would flip a triangle, vertices only move onto their neighbours so the result indexes the same
+// vertices, vertices sharing a position are welded and the result keeps the first of them
+//
+// error is set to the square root of the costliest collapse made, the mean squared distance of the vertex left to the
+// planes of the triangles around both ends of the edge weighted by their area, in the units of the positions, it
+// estimates how far the result strays from the input but does not bound it
+std::vector<uint32_t> simplifyMesh(const Vertex *vertices, uint32_t vertexCount, const std::vector<uint32_t> &indices,
+                                   uint32_t targetIndexCount, float &error);
+
+} // namespace Cthovk
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graphics.h"
+#include "workers.h"
+
+namespace Cthovk
+{
+
+// parses the v and f lines of an obj file into one mesh of unique vertices, every other statement is skipped
+//
+// the result matches deduplicating the faces tinyobjloader returns in file order: vertices are numbered by their first
+// use, numbers are parsed and quads are split the way it does, larger polygons become fans. colorize gives the color
+// of every position and is called from the worker threads, without it the colors of the file are used (white when
+// it has none)
+void importObj(const std::string &location, WorkerPool &workers, std::vector<Vertex> &vertices,
+               std::vector<uint32_t> &indices, const std::function<glm::vec3(const glm::vec3 &pos)> &colorize = nullptr);
+
+} // namespace Cthovk
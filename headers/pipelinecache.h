@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Cthovk
+{
+
+struct PipelineCacheStats
+{
+    bool loaded{false}; // a blob from disk was accepted and seeded the cache
+    size_t loadedBytes{0};
+    uint32_t hits{0};
+    uint32_t misses{0};
+    uint32_t unknown{0};      // pipelines created without VK_EXT_pipeline_creation_feedback
+    uint64_t creationTime{0}; // nanoseconds spent creating pipelines
+};
+
+// VkPipelineCache persisted between runs, a blob on disk is only used when it was written by the same device
+// and driver version, otherwise the cache starts empty and the file is replaced on destruction
+struct PipelineCacheObj
+{
+    VkDevice logDevice;
+    VkPipelineCache cache;
+    std::string location; // empty keeps the cache in memory only
+    PipelineCacheStats stats;
+
+    VkPipeline createGraphicsPipeline(VkGraphicsPipelineCreateInfo pipelineInfo);
+    VkPipeline createComputePipeline(VkComputePipelineCreateInfo pipelineInfo);
+    // writes the cache to a temporary file and renames it over location once it is synced to the disk,
+    // so a crash leaves either the old file or the new one but never a torn one
+    bool save();
+
+    PipelineCacheObj(VkDevice logDevice, VkPhysicalDevice phyDevice, std::string location, bool feedback);
+    ~PipelineCacheObj();
+
+  private:
+    VkPhysicalDeviceProperties properties;
+    bool feedback;
+
+    bool load(std::vector<char> &data);
+    // create is called with the pNext chain to use, extended by the creation feedback when it is enabled
+    VkPipeline createPipeline(const void *pNext,
+                              const std::function<VkResult(const void *pNext, VkPipeline *pipeline)> &create);
+};
+
+} // namespace Cthovk
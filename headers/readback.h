@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "graphics.h"
+
+namespace Cthovk
+{
+
+// copies finished swapchain or offscreen frames into a ring of persistently mapped host cached buffers, host
+// coherent ones on devices without cached memory, a consumer thread waits for every copy and hands the pixels to the
+// callback in place, the render loop never waits on it
+//
+// a frame is dropped instead of stalling the render loop when the consumer still holds every slot
+struct ReadbackObj
+{
+    struct Slot
+    {
+        BufferObj *buffer{nullptr}; // Count holds the capacity in bytes
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+        ReadbackFrame frame;
+        bool submitted{false}; // owned by the consumer thread until it handed the frame out
+    };
+
+    VkDevice logDevice;
+    MemoryAllocator *allocator;
+    VkCommandPool pool;
+    VkDeviceSize atomSize; // nonCoherentAtomSize, host cached memory is invalidated before it is read
+    VkMemoryPropertyFlags hostMemory; // of the slot buffers
+    std::function<void(const ReadbackFrame &frame)> frameReadback;
+
+    // slot the next captured frame is copied to, UINT32_MAX when the consumer still holds it and the frame has to be
+    // dropped
+    uint32_t reserve();
+    // records the copy of image (in layout, restored afterwards) into the reserved slot and submits it on queue,
+    // signal is signaled once the copy finished reading the image
+    void capture(uint32_t slot, VkQueue queue, VkImage image, VkImageLayout layout, VkFormat format, VkExtent2D extent,
+                 uint64_t number, VkSemaphore signal);
+    // sizes every slot for frames of format and extent, waits until the consumer handed out the frames it holds
+    void resize(VkFormat format, VkExtent2D extent);
+
+    // queueFamily is the one capture submits to, the slots are sized for frames of format and extent
+    ReadbackObj(VkDevice logDevice, VkPhysicalDevice phyDevice, MemoryAllocator &allocator, uint32_t queueFamily,
+                uint32_t slotCount, VkFormat format, VkExtent2D extent,
+                std::function<void(const ReadbackFrame &frame)> frameReadback);
+    // hands out every frame already captured before returning
+    ~ReadbackObj();
+
+  private:
+    std::vector<Slot> slots;
+    uint32_t next{0}; // slot the render loop fills next
+    uint64_t dropped{0};
+    std::thread consumer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping{false};
+    std::exception_ptr error; // thrown by frameReadback, rethrown by the next capture
+
+    void consume();
+};
+
+} // namespace Cthovk
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Cthovk
+{
+
+static const uint32_t noParent{UINT32_MAX};
+
+// translation, rotation and scale of a range of slots, stored component by component so the model matrices of four
+// slots are built at once with SSE, every slot starts out as the identity and without a parent
+//
+// the transform of a slot with a parent is relative to the parent, children are linked to their parents so that
+// setting a parent or detaching a slot only touches the slots involved
+struct TransformBatchObj
+{
+    std::vector<float> translationX, translationY, translationZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW; // unit quaternions
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<uint32_t> parents; // noParent for roots
+    std::vector<uint32_t> firstChildren;
+    std::vector<uint32_t> nextSiblings;
+    std::vector<uint32_t> previousSiblings;
+    std::vector<uint32_t> order; // every slot with a parent, after the parent, rebuilt once the hierarchy changed
+    uint32_t childSlots{0};      // slots with a parent
+    bool orderStale{false};
+
+    void resize(uint32_t count);
+    void set(uint32_t slot, glm::vec3 translation, glm::quat rotation, glm::vec3 scale);
+    // noParent makes the slot a root again, throws if slot is parent itself or one of its ancestors
+    void setParent(uint32_t slot, uint32_t parent);
+    // makes the slot and its children roots, the children keep their transforms which are no longer relative
+    void detach(uint32_t slot);
+    // translate * rotate * scale
+    glm::mat4 matrix(uint32_t slot) const;
+    // writes the matrices of the slots in [first, last) to destination, the one of slot i at stride * i bytes
+    void writeMatrices(uint32_t first, uint32_t last, void *destination, size_t stride) const;
+    // turns the matrices written by writeMatrices at a stride of one matrix into the ones relative to the roots, with
+    // one pass over the children that sees every parent before its children
+    void composeHierarchy(glm::mat4 *matrices);
+};
+
+} // namespace Cthovk
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "memory.h"
+
+namespace Cthovk
+{
+
+// packs many buffer uploads into one persistently mapped staging ring and records them into a single command
+// buffer, every submission completes with a ticket that can be polled or waited on
+//
+// when the copies run on a queue family other than the one consuming the buffers (a dedicated transfer queue)
+// every submission releases the written ranges and signals a semaphore, handoff() later acquires them on the
+// consuming queue once the copies finished so the consumer never stalls on an upload still in flight, only the
+// written ranges change family so the rest of a shared buffer stays in use meanwhile
+struct UploadBatchObj
+{
+    struct Region
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Submission
+    {
+        VkCommandBuffer commandBuffer;
+        VkCommandBuffer acquireBuffer{VK_NULL_HANDLE}; // recorded on the consuming family, ownership transfers only
+        VkFence fence;                                 // signals once the buffers are usable by the consumer
+        VkFence transferFence{VK_NULL_HANDLE};         // signals once the copies finished, ownership transfers only
+        VkSemaphore semaphore{VK_NULL_HANDLE};
+        std::vector<Region> regions; // destination ranges changing queue family
+        uint64_t ticket{0};
+        VkDeviceSize ringBytes{0}; // staging bytes (including wrap padding) released when the fence signals
+        bool pending{false};
+        bool handedOff{false};
+    };
+
+    VkDevice logDevice;
+    VkQueue queue;
+    VkQueue dstQueue;
+    uint32_t queueFamily;
+    uint32_t dstFamily;
+    VkCommandPool pool;
+    VkCommandPool dstPool{VK_NULL_HANDLE};
+    VkBuffer staging;
+    Allocation stagingMemory;
+    VkDeviceSize capacity;
+    MemoryAllocator *allocator;
+
+    // records the copy now and returns the ticket of the submission it will be part of
+    uint64_t enqueue(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+    // same as above with the size bytes written straight into the staging ring by fill, once per chunk of an upload
+    // bigger than the ring, offset is the one of the chunk in the upload
+    uint64_t enqueue(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size,
+                     const std::function<void(void *staging, VkDeviceSize offset, VkDeviceSize chunk)> &fill);
+    // submits everything recorded since the last submit, returns the ticket of the submission
+    uint64_t submit();
+    // acquires the buffers of every finished submission on dstQueue, must be called before the dstQueue
+    // submission that uses them, with block set it waits for the copies instead of skipping unfinished ones
+    void handoff(bool block = false);
+    // buffers of a ready ticket may be used by any dstQueue submission made from now on
+    bool isReady(uint64_t ticket) const;
+    bool isComplete(uint64_t ticket);
+    void wait(uint64_t ticket);
+    bool ownershipTransfer() const;
+
+    // queueFamily and queue run the copies, dstFamily and dstQueue consume the uploaded buffers
+    UploadBatchObj(VkDevice logDevice, MemoryAllocator &allocator, uint32_t queueFamily, VkQueue queue,
+                   uint32_t dstFamily, VkQueue dstQueue, VkDeviceSize capacity, uint32_t maxSubmissions = 4);
+    ~UploadBatchObj();
+
+  private:
+    std::vector<Submission> submissions;
+    std::vector<VkBufferMemoryBarrier> barriers; // of the submission being submitted, ownership transfers only
+    uint32_t recording{UINT32_MAX}; // submission currently being recorded
+    uint32_t oldest{0};
+    uint32_t pendingCount{0};
+    uint64_t nextTicket{1};
+    uint64_t readyTicket{0};
+    uint64_t completedTicket{0};
+    VkDeviceSize head{0};
+    VkDeviceSize tail{0};
+    VkDeviceSize used{0};
+
+    bool reserve(VkDeviceSize size, VkDeviceSize &offset, VkDeviceSize &consumed);
+    void beginRecording();
+    bool handoffNext(bool block);
+    bool retireOldest(bool block);
+};
+
+} // namespace Cthovk
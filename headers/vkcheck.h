@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdexcept>
+
+#include <vulkan/vulkan_core.h>
+
+namespace Cthovk
+{
+
+// throws on error codes only, success codes like VK_SUBOPTIMAL_KHR or VK_INCOMPLETE pass
+inline void vkCheck(VkResult result, const char *error)
+{
+    if (result < 0)
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+} // namespace Cthovk
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Cthovk
+{
+
+// fixed set of threads running one job at a time, the calling thread takes tasks too until every task finished
+class WorkerPool
+{
+  public:
+    // calls job(task) for every task in [0, taskCount) and returns once all of them finished, the first exception
+    // thrown by a task is rethrown here
+    void run(const std::function<void(uint32_t task)> &job, uint32_t taskCount);
+    // threads working on a job, including the calling one
+    uint32_t size() const;
+
+    WorkerPool(uint32_t threadCount);
+    ~WorkerPool();
+
+  private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(uint32_t task)> *job{nullptr};
+    uint32_t taskCount{0};
+    std::atomic<uint32_t> nextTask{0};
+    uint32_t finishedTasks{0};
+    uint32_t activeThreads{0}; // workers that joined the current job and did not leave it yet
+    uint64_t generation{0};
+    bool stopping{false};
+    std::exception_ptr error;
+
+    void work();
+    void drain();
+};
+
+} // namespace Cthovk
@@ -3,19 +3,32 @@
 namespace Cthovk
 {
 
-Application::Application(DeviceInfo deviceInfo, GraphicsInfo graphicsInfo, std::function<bool()> terminateCheck)
+Application::Application(DeviceInfo deviceInfo, const GraphicsInfo &graphicsInfo,
+                         std::function<bool()> terminateCheck)
     : device(deviceInfo), graphics(device.logDevice, device.phyDevice, device.surface, device.findDepthFormat(),
-                                   device.queues.graphics, graphicsInfo),
-      terminateCheck(terminateCheck), grInfo(graphicsInfo)
+                                   device.queues, device.features, graphicsInfo),
+      terminateCheck(terminateCheck)
 {
 }
 
 void Application::run()
 {
-    while (!terminateCheck())
+    CpuProfiler &profiler = graphics.getCpuProfiler();
+    while (true)
     {
-        graphics.draw(device.phyDevice, device.surface, grInfo, device.queues.graphics, device.queues.present);
+        uint64_t phase = profiler.begin();
+        bool terminate = terminateCheck();
+        profiler.end("events", phase);
+        if (terminate)
+            break;
+        graphics.draw(device.phyDevice, device.surface, device.queues.graphics, device.queues.present);
     }
+    graphics.flushFrames();
+}
+
+Graphics &Application::getGraphics()
+{
+    return graphics;
 }
 
 Application::~Application()
@@ -0,0 +1,193 @@
+#include "../headers/cpuprofiler.h"
+
+namespace Cthovk
+{
+
+static std::atomic<uint64_t> nextProfilerId{1};
+
+static uint64_t now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// nearest rank, sorted holds at least one time
+static uint64_t percentile(const std::vector<uint64_t> &sorted, uint32_t perMille)
+{
+    size_t rank = (sorted.size() * perMille + 999) / 1000;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+CpuProfiler::CpuProfiler(bool enabled, uint32_t eventsPerThread)
+    : enabled(enabled), id(nextProfilerId++), origin(now()), eventsPerThread(std::max(eventsPerThread, 1u)),
+      frameTimes(new std::atomic<uint64_t>[window]())
+{
+}
+
+void CpuProfiler::setEnabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool CpuProfiler::isEnabled() const
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t CpuProfiler::begin() const
+{
+    if (!enabled.load(std::memory_order_relaxed))
+        return 0;
+    return now();
+}
+
+void CpuProfiler::end(const char *name, uint64_t begin)
+{
+    if (begin == 0)
+        return;
+    uint64_t finish = now();
+    ThreadRing &target = ring();
+    uint64_t index = target.written.load(std::memory_order_relaxed);
+    // readers that see any of the stores below also see every count published before them
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &event = target.events[index % eventsPerThread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(finish, std::memory_order_relaxed);
+    target.written.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::beginFrame()
+{
+    uint64_t start = begin();
+    if (start != 0 && frameStart != 0)
+    {
+        end("frame", frameStart);
+        uint64_t count = frameCount.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frameTimes[count % window].store(start - frameStart, std::memory_order_relaxed);
+        frameCount.store(count + 1, std::memory_order_release);
+    }
+    frameStart = start;
+}
+
+CpuFrameStats CpuProfiler::getFrameStats() const
+{
+    uint64_t count = frameCount.load(std::memory_order_acquire);
+    uint64_t first = count > window ? count - window : 0;
+    std::vector<uint64_t> times;
+    times.reserve(count - first);
+    for (uint64_t i{first}; i < count; ++i)
+    {
+        times.push_back(frameTimes[i % window].load(std::memory_order_relaxed));
+    }
+    // frames written meanwhile overwrote the oldest copied ones
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t written = frameCount.load(std::memory_order_relaxed);
+    if (written >= first + window)
+        times.erase(times.begin(), times.begin() + std::min<uint64_t>(written - first - window + 1, times.size()));
+
+    CpuFrameStats stats;
+    stats.frames = static_cast<uint32_t>(times.size());
+    if (times.empty())
+        return stats;
+    std::sort(times.begin(), times.end());
+    stats.p50 = percentile(times, 500);
+    stats.p99 = percentile(times, 990);
+    stats.p999 = percentile(times, 999);
+    stats.maxTime = times.back();
+    return stats;
+}
+
+void CpuProfiler::writeTrace(const std::string &location) const
+{
+    std::ofstream file(location, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open CPU trace: " + location);
+    file << std::fixed << std::setprecision(3);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool firstEvent{true};
+    for (uint32_t i{0}; i < rings.size(); ++i)
+    {
+        const ThreadRing &source = *rings[i];
+        uint64_t count = source.written.load(std::memory_order_acquire);
+        uint64_t first = count > eventsPerThread ? count - eventsPerThread : 0;
+        std::vector<const char *> names;
+        std::vector<uint64_t> begins;
+        std::vector<uint64_t> ends;
+        for (uint64_t j{first}; j < count; ++j)
+        {
+            const Event &event = source.events[j % eventsPerThread];
+            names.push_back(event.name.load(std::memory_order_relaxed));
+            begins.push_back(event.begin.load(std::memory_order_relaxed));
+            ends.push_back(event.end.load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t written = source.written.load(std::memory_order_relaxed);
+        uint64_t skipped = written >= first + eventsPerThread ? written - first - eventsPerThread + 1 : 0;
+
+        file << (firstEvent ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+             << source.index << ",\"args\":{\"name\":\"thread " << source.index << "\"}}";
+        firstEvent = false;
+        for (uint64_t j{skipped}; j < names.size(); ++j)
+        {
+            // timestamps are microseconds since the profiler was created
+            file << ",\n{\"name\":\"" << names[j] << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << source.index
+                 << ",\"ts\":" << (begins[j] - origin) / 1000.0 << ",\"dur\":" << (ends[j] - begins[j]) / 1000.0
+                 << "}";
+        }
+    }
+    file << "\n]}\n";
+    if (!file.good())
+        throw std::runtime_error("failed to write CPU trace: " + location);
+}
+
+CpuProfiler::ThreadRing &CpuProfiler::ring()
+{
+    struct Cache
+    {
+        uint64_t profiler{0};
+        ThreadRing *ring{nullptr};
+    };
+    thread_local Cache cache;
+    if (cache.profiler == id)
+        return *cache.ring;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::thread::id thread = std::this_thread::get_id();
+    ThreadRing *found{nullptr};
+    for (uint32_t i{0}; i < rings.size() && found == nullptr; ++i)
+    {
+        if (rings[i]->thread == thread)
+            found = rings[i].get();
+    }
+    if (found == nullptr)
+    {
+        rings.push_back(std::make_unique<ThreadRing>());
+        found = rings.back().get();
+        found->thread = thread;
+        found->index = static_cast<uint32_t>(rings.size() - 1);
+        found->events.reset(new Event[eventsPerThread]);
+    }
+    cache = {
+        .profiler = id,
+        .ring = found,
+    };
+    return *found;
+}
+
+CpuScope::CpuScope(CpuProfiler *profiler, const char *name)
+    : profiler(profiler), name(name), start(profiler != nullptr ? profiler->begin() : 0)
+{
+}
+
+CpuScope::~CpuScope()
+{
+    if (profiler != nullptr)
+        profiler->end(name, start);
+}
+
+} // namespace Cthovk
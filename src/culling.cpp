@@ -0,0 +1,167 @@
+#include "../headers/culling.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+// objects, draws, bounds, culled draws, culled counts and the camera
+static const std::vector<VkDescriptorType> cullBindings{
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+};
+static const uint32_t groupSize{64};
+
+CullObj::CullObj(VkDevice logDevice, uint32_t queueFamily, VkQueue queue, uint32_t framesInFlight,
+                 std::string shaderLocation, PipelineCacheObj &cache, bool compact)
+    : logDevice(logDevice), queue(queue), versions(framesInFlight, 0),
+      descriptors(logDevice, 1, framesInFlight, cullBindings, VK_SHADER_STAGE_COMPUTE_BIT), compact(compact)
+{
+    VkCommandPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+    vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &pool), "failed to create culling command pool");
+    commandBuffers.resize(framesInFlight);
+    VkCommandBufferAllocateInfo cbInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = framesInFlight,
+    };
+    vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, commandBuffers.data()),
+            "failed to create culling command buffers");
+
+    semaphores.resize(framesInFlight);
+    VkSemaphoreCreateInfo semaphoreInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        vkCheck(vkCreateSemaphore(logDevice, &semaphoreInfo, nullptr, &semaphores[i]),
+                "failed to create culling semaphore");
+    }
+
+    descriptorSets.resize(framesInFlight);
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptors.descriptorlayout);
+    VkDescriptorSetAllocateInfo dInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptors.descriptorPool,
+        .descriptorSetCount = framesInFlight,
+        .pSetLayouts = layouts.data(),
+    };
+    vkCheck(vkAllocateDescriptorSets(logDevice, &dInfo, descriptorSets.data()),
+            "failed to allocate culling descriptor sets");
+
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(PushConstants),
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptors.descriptorlayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    vkCheck(vkCreatePipelineLayout(logDevice, &pipelineLayoutInfo, nullptr, &layout),
+            "failed to create culling pipeline layout");
+
+    ShaderObj shader(logDevice, shaderLocation, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkComputePipelineCreateInfo pipelineInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = shader.stageInfo,
+        .layout = layout,
+    };
+    pipeline = cache.createComputePipeline(pipelineInfo);
+}
+
+void CullObj::bind(uint32_t frame, const IndirectFrameObj &indirect)
+{
+    VkBuffer buffers[6]{indirect.objectData->buffer,   indirect.commands->buffer,
+                        indirect.bounds->buffer,       indirect.culledCommands->buffer,
+                        indirect.culledCounts->buffer, indirect.camera->buffer};
+    VkDescriptorBufferInfo bufferInfos[6];
+    VkWriteDescriptorSet descriptorWrites[6];
+    for (uint32_t i{0}; i < 6; ++i)
+    {
+        bufferInfos[i] = {
+            .buffer = buffers[i],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+        descriptorWrites[i] = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSets[frame],
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = cullBindings[i],
+            .pBufferInfo = &bufferInfos[i],
+        };
+    }
+    vkUpdateDescriptorSets(logDevice, 6, descriptorWrites, 0, nullptr);
+    versions[frame] = 0;
+}
+
+VkSemaphore CullObj::cull(uint32_t frame, const IndirectFrameObj &indirect)
+{
+    // the graphics submission that waited on the previous culling of this frame has finished, the command
+    // buffer is free to be recorded again
+    VkCommandBuffer commandBuffer = commandBuffers[frame];
+    if (versions[frame] != indirect.version)
+    {
+        vkResetCommandBuffer(commandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        };
+        vkCheck(vkBeginCommandBuffer(commandBuffer, &beginInfo), "failed to record culling buffer");
+
+        // the counts start at zero every frame, the shader bumps them for every visible draw
+        vkCmdFillBuffer(commandBuffer, indirect.culledCounts->buffer, 0, VK_WHOLE_SIZE, 0);
+        VkMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+
+        PushConstants pushConstants{
+            .commandCount = indirect.commandCount,
+            .compact = compact ? 1u : 0u,
+        };
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &descriptorSets[frame], 0,
+                                nullptr);
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+                           &pushConstants);
+        vkCmdDispatch(commandBuffer, (indirect.commandCount + groupSize - 1) / groupSize, 1, 1);
+        vkCheck(vkEndCommandBuffer(commandBuffer), "failed to record culling buffer");
+        versions[frame] = indirect.version;
+    }
+
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &semaphores[frame],
+    };
+    vkCheck(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "failed to submit culling");
+    return semaphores[frame];
+}
+
+CullObj::~CullObj()
+{
+    vkDestroyPipeline(logDevice, pipeline, nullptr);
+    vkDestroyPipelineLayout(logDevice, layout, nullptr);
+    for (uint32_t i{0}; i < semaphores.size(); ++i)
+    {
+        vkDestroySemaphore(logDevice, semaphores[i], nullptr);
+    }
+    vkDestroyCommandPool(logDevice, pool, nullptr);
+}
+
+} // namespace Cthovk
@@ -1,22 +1,16 @@
 #include "../headers/device.h"
+#include "../headers/vkcheck.h"
 
 namespace Cthovk
 {
 
-void vkCheck(bool result, const char *error)
-{
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error(error);
-    }
-}
-
 Device::Device(DeviceInfo inf)
 {
     initInstance(inf.enableVL, inf.vl, inf.windowExt);
     if (inf.enableVL)
         initValidationLayers();
-    inf.initSurface(instance, &surface);
+    if (inf.initSurface)
+        inf.initSurface(instance, &surface);
     selectGPU(inf.deviceExt);
     initLogDevice(inf.enableVL, inf.deviceExt, inf.vl);
 }
@@ -135,14 +129,15 @@ uint32_t Device::rateGPU(VkPhysicalDevice device, std::vector<const char *> devi
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamiliesList.data());
 
     bool foundGrFamily{false};
-    bool foundPrFamily{false};
+    bool foundPrFamily{surface == VK_NULL_HANDLE}; // headless devices never present
     bool foundCoFamily{false};
     for (uint32_t i{0}; i < queueFamilyCount; ++i)
     {
         if (queueFamiliesList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
             foundGrFamily = true;
         VkBool32 presentSupport{false};
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE)
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
         if (presentSupport)
             foundPrFamily = true;
         if (queueFamiliesList[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
@@ -170,16 +165,19 @@ uint32_t Device::rateGPU(VkPhysicalDevice device, std::vector<const char *> devi
     if (commonExtensions != deviceExt.size())
         return 0;
 
-    // check formats
-    uint32_t availableFormatsCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &availableFormatsCount, nullptr);
-    if (availableFormatsCount == 0)
-        return 0;
-
-    uint32_t availablePresentModesCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &availablePresentModesCount, nullptr);
-    if (availablePresentModesCount == 0)
-        return 0;
+    // check formats, headless devices render to images of any format they support
+    if (surface != VK_NULL_HANDLE)
+    {
+        uint32_t availableFormatsCount;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &availableFormatsCount, nullptr);
+        if (availableFormatsCount == 0)
+            return 0;
+
+        uint32_t availablePresentModesCount;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &availablePresentModesCount, nullptr);
+        if (availablePresentModesCount == 0)
+            return 0;
+    }
 
     // basic for now may change later
     int32_t rating{1};
@@ -216,7 +214,7 @@ void Device::selectGPU(std::vector<const char *> deviceExt)
     if (ratings[maxRater] == 0)
         throw std::runtime_error("no suitable GPUs found");
 
-    phyDevice = devices[0];
+    phyDevice = devices[maxRater];
 }
 
 void Device::initLogDevice(bool useVL, std::vector<const char *> deviceExt, std::vector<const char *> validationLayers)
@@ -226,42 +224,56 @@ void Device::initLogDevice(bool useVL, std::vector<const char *> deviceExt, std:
     std::vector<VkQueueFamilyProperties> queueFamiliesList(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &queueFamilyCount, queueFamiliesList.data());
 
-    std::vector<uint32_t> queueFamilies(3, UINT32_MAX);
-    bool foundGrFamily{false};
-    bool foundPrFamily{false};
-    bool foundCoFamily{false};
+    queues.graphicsFamily = UINT32_MAX;
+    queues.presentFamily = UINT32_MAX;
+    queues.computeFamily = UINT32_MAX;
+    queues.transferFamily = UINT32_MAX;
     for (uint32_t i{0}; i < queueFamilyCount; ++i)
     {
-        if (queueFamiliesList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && !foundGrFamily)
-        {
-            queueFamilies[0] = i;
-            foundGrFamily = true;
-        }
+        if (queueFamiliesList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && queues.graphicsFamily == UINT32_MAX)
+            queues.graphicsFamily = i;
 
-        if (!foundPrFamily)
+        if (queues.presentFamily == UINT32_MAX && surface != VK_NULL_HANDLE)
         {
             VkBool32 presentSupport{false};
             vkGetPhysicalDeviceSurfaceSupportKHR(phyDevice, i, surface, &presentSupport);
             if (presentSupport)
-            {
-                queueFamilies[1] = i;
-                foundPrFamily = true;
-            }
+                queues.presentFamily = i;
         }
 
-        if (queueFamiliesList[i].queueFlags & VK_QUEUE_COMPUTE_BIT && !foundCoFamily)
-        {
-            queueFamilies[2] = i;
-            foundCoFamily = true;
-        }
+        // a compute family without graphics runs culling next to the rendering of the previous frame
+        if (queueFamiliesList[i].queueFlags & VK_QUEUE_COMPUTE_BIT &&
+            !(queueFamiliesList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && queues.computeFamily == UINT32_MAX)
+            queues.computeFamily = i;
+
+        // a family that can only copy usually maps to the dedicated DMA engines of the GPU
+        if (queueFamiliesList[i].queueFlags & VK_QUEUE_TRANSFER_BIT &&
+            !(queueFamiliesList[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            queues.transferFamily == UINT32_MAX)
+            queues.transferFamily = i;
     }
-    std::sort(queueFamilies.begin(), queueFamilies.end());
-    queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+    if (queues.transferFamily == UINT32_MAX)
+        queues.transferFamily = queues.graphicsFamily;
+    // the graphics family usually computes as well, any other one does otherwise
+    if (queues.computeFamily == UINT32_MAX &&
+        queueFamiliesList[queues.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT)
+        queues.computeFamily = queues.graphicsFamily;
+    for (uint32_t i{0}; queues.computeFamily == UINT32_MAX && i < queueFamilyCount; ++i)
+    {
+        if (queueFamiliesList[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+            queues.computeFamily = i;
+    }
+    // headless devices never present, the present queue is only there to keep QueueObj complete
+    if (queues.presentFamily == UINT32_MAX)
+        queues.presentFamily = queues.graphicsFamily;
 
+    std::set<uint32_t> queueFamilies = {queues.graphicsFamily, queues.presentFamily, queues.computeFamily,
+                                        queues.transferFamily};
+    float queuePriority{1.0f};
     VkDeviceQueueCreateInfo queueCreateInfo{
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
         .queueCount = 1,
-        .pQueuePriorities = new float(1.0f),
+        .pQueuePriorities = &queuePriority,
     };
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(queueFamilies.size());
     for (uint8_t i{0}; i < queueFamilies.size(); ++i)
@@ -270,6 +282,40 @@ void Device::initLogDevice(bool useVL, std::vector<const char *> deviceExt, std:
         queueCreateInfos[i].queueFamilyIndex = *(std::next(queueFamilies.begin(), i));
     }
 
+    // optional extensions are enabled whenever the GPU supports them
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(phyDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExt(extensionCount);
+    vkEnumerateDeviceExtensionProperties(phyDevice, nullptr, &extensionCount, availableExt.data());
+    auto enableOptional = [&](const char *extension) {
+        bool available{false};
+        for (uint32_t i{0}; i < extensionCount; ++i)
+        {
+            if (std::strcmp(availableExt[i].extensionName, extension) == 0)
+                available = true;
+        }
+        if (!available)
+            return false;
+        for (uint32_t i{0}; i < deviceExt.size(); ++i)
+        {
+            if (std::strcmp(deviceExt[i], extension) == 0)
+                return true;
+        }
+        deviceExt.push_back(extension);
+        return true;
+    };
+    features.pipelineCreationFeedback = enableOptional(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    features.drawIndirectCount = enableOptional(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(phyDevice, &supportedFeatures);
+    VkPhysicalDeviceFeatures enabledFeatures{
+        .multiDrawIndirect = supportedFeatures.multiDrawIndirect,
+        .drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance,
+    };
+    features.multiDrawIndirect = enabledFeatures.multiDrawIndirect;
+    features.drawIndirectFirstInstance = enabledFeatures.drawIndirectFirstInstance;
+
     VkDeviceCreateInfo logDeviceInfo{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
@@ -278,32 +324,22 @@ void Device::initLogDevice(bool useVL, std::vector<const char *> deviceExt, std:
         .ppEnabledLayerNames = useVL ? validationLayers.data() : nullptr,
         .enabledExtensionCount = static_cast<uint32_t>(deviceExt.size()),
         .ppEnabledExtensionNames = deviceExt.data(),
-        .pEnabledFeatures = nullptr,
+        .pEnabledFeatures = &enabledFeatures,
     };
     vkCheck(vkCreateDevice(phyDevice, &logDeviceInfo, nullptr, &logDevice), "failed to initialize logic device");
 
-    // retrieve queue handle
-    vkGetDeviceQueue(logDevice, queueFamilies[0], 0, &queues.graphics);
-    queues.present = queues.graphics;
-    queues.compute = queues.graphics;
-    if (queueFamilies[1] != queueFamilies[0])
-    {
-        vkGetDeviceQueue(logDevice, queueFamilies[1], 0, &queues.present);
-    }
-    if (queueFamilies[2] != queueFamilies[0] && queueFamilies[2] != queueFamilies[1])
-    {
-        vkGetDeviceQueue(logDevice, queueFamilies[2], 0, &queues.compute);
-    }
-    else if (queueFamilies[2] != queueFamilies[0])
-    {
-        queues.compute = queues.present;
-    }
+    // retrieve queue handle, roles sharing a family share its single queue
+    vkGetDeviceQueue(logDevice, queues.graphicsFamily, 0, &queues.graphics);
+    vkGetDeviceQueue(logDevice, queues.presentFamily, 0, &queues.present);
+    vkGetDeviceQueue(logDevice, queues.computeFamily, 0, &queues.compute);
+    vkGetDeviceQueue(logDevice, queues.transferFamily, 0, &queues.transfer);
 }
 
 Device::~Device()
 {
     vkDestroyDevice(logDevice, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(instance, surface, nullptr);
     if (messenger != nullptr)
     {
         vkDestroyDebugUtilsMessengerEXT(instance, messenger, nullptr);
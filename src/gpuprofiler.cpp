@@ -0,0 +1,171 @@
+#include "../headers/gpuprofiler.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+GpuProfiler::GpuProfiler(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t queueFamily,
+                         uint32_t framesInFlight, std::string csvLocation, uint32_t maxIntervals)
+    : logDevice(logDevice), pools(framesInFlight), submitted(framesInFlight, NONE), results(2 * maxIntervals),
+      maxIntervals(maxIntervals)
+{
+    uint32_t queueFamilyCount{0};
+    vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamiliesList(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &queueFamilyCount, queueFamiliesList.data());
+    uint32_t validBits = queueFamiliesList[queueFamily].timestampValidBits;
+    if (validBits == 0)
+        throw std::runtime_error("queue family does not support timestamps");
+    validMask = validBits == 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+    period = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * maxIntervals,
+    };
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        vkCheck(vkCreateQueryPool(logDevice, &poolInfo, nullptr, &pools[i]), "failed to create query pool");
+    }
+
+    if (!csvLocation.empty())
+    {
+        csv.open(csvLocation, std::ios::trunc);
+        if (!csv.is_open())
+            throw std::runtime_error("failed to open GPU profile: " + csvLocation);
+        csv << "frame,scope,nanoseconds\n";
+    }
+}
+
+uint32_t GpuProfiler::scope(const std::string &name)
+{
+    for (uint32_t i{0}; i < scopes.size(); ++i)
+    {
+        if (scopes[i].name == name)
+            return i;
+    }
+    scopes.push_back(Scope{
+        .name = name,
+        .times = std::vector<uint64_t>(window),
+    });
+    return static_cast<uint32_t>(scopes.size() - 1);
+}
+
+void GpuProfiler::beginBuffer(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t frame)
+{
+    if (buffer >= recordings.size())
+        recordings.resize(buffer + 1);
+    recordings[buffer].frame = frame;
+    recordings[buffer].scopes.clear();
+    // queries can only be reset outside of a render pass
+    vkCmdResetQueryPool(commandBuffer, pools[frame], 0, 2 * maxIntervals);
+}
+
+uint32_t GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t scope)
+{
+    Recording &recording = recordings[buffer];
+    if (recording.scopes.size() == maxIntervals)
+        return NONE;
+    uint32_t interval = static_cast<uint32_t>(recording.scopes.size());
+    recording.scopes.push_back(scope);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pools[recording.frame], 2 * interval);
+    return interval;
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t buffer, uint32_t interval)
+{
+    if (interval == NONE)
+        return;
+    Recording &recording = recordings[buffer];
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pools[recording.frame],
+                        2 * interval + 1);
+}
+
+void GpuProfiler::submit(uint32_t frame, uint32_t buffer)
+{
+    submitted[frame] = buffer;
+}
+
+void GpuProfiler::resolve(uint32_t frame)
+{
+    uint32_t buffer = submitted[frame];
+    if (buffer == NONE)
+        return;
+    submitted[frame] = NONE;
+    const std::vector<uint32_t> &intervals = recordings[buffer].scopes;
+    if (intervals.empty())
+        return;
+
+    // the fence of the frame signaled, results that are still missing are skipped rather than waited for
+    uint32_t queryCount = 2 * static_cast<uint32_t>(intervals.size());
+    if (vkGetQueryPoolResults(logDevice, pools[frame], 0, queryCount, sizeof(uint64_t) * queryCount, results.data(),
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+    resolvedFrames++;
+    for (uint32_t i{0}; i < intervals.size(); ++i)
+    {
+        Scope &scope = scopes[intervals[i]];
+        uint64_t ticks = (results[2 * i + 1] - results[2 * i]) & validMask;
+        scope.frameTime += static_cast<uint64_t>(ticks * period);
+        scope.written = true;
+    }
+    for (uint32_t i{0}; i < scopes.size(); ++i)
+    {
+        Scope &scope = scopes[i];
+        if (!scope.written)
+            continue;
+        scope.times[scope.next] = scope.frameTime;
+        scope.next = (scope.next + 1) % window;
+        scope.samples = std::min(scope.samples + 1, window);
+        if (csv.is_open())
+            csv << resolvedFrames << ',' << scope.name << ',' << scope.frameTime << '\n';
+        scope.frameTime = 0;
+        scope.written = false;
+    }
+}
+
+std::vector<GpuScopeStats> GpuProfiler::getStats() const
+{
+    std::vector<GpuScopeStats> stats(scopes.size());
+    for (uint32_t i{0}; i < scopes.size(); ++i)
+    {
+        const Scope &scope = scopes[i];
+        stats[i].name = scope.name;
+        stats[i].samples = scope.samples;
+        if (scope.samples == 0)
+            continue;
+        stats[i].minTime = UINT64_MAX;
+        uint64_t total{0};
+        for (uint32_t j{0}; j < scope.samples; ++j)
+        {
+            stats[i].minTime = std::min(stats[i].minTime, scope.times[j]);
+            stats[i].maxTime = std::max(stats[i].maxTime, scope.times[j]);
+            total += scope.times[j];
+        }
+        stats[i].avgTime = total / scope.samples;
+    }
+    return stats;
+}
+
+void GpuProfiler::resetStats()
+{
+    for (uint32_t i{0}; i < scopes.size(); ++i)
+    {
+        scopes[i].next = 0;
+        scopes[i].samples = 0;
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (uint32_t i{0}; i < pools.size(); ++i)
+    {
+        vkDestroyQueryPool(logDevice, pools[i], nullptr);
+    }
+}
+
+} // namespace Cthovk
@@ -1,67 +1,762 @@
 #include "../headers/graphics.h"
+#include "../headers/culling.h"
+#include "../headers/meshfile.h"
+#include "../headers/meshlet.h"
+#include "../headers/meshoptimize.h"
+#include "../headers/meshsimplify.h"
+#include "../headers/readback.h"
+#include "../headers/vkcheck.h"
 
 namespace Cthovk
 {
 
-static void vkCheck(bool result, const char *error)
+static const uint32_t transformChunk{1024}; // objects whose model matrices one task builds, a multiple of 4
+
+// GPU profiler scope of the draws of one pipeline
+static std::string drawScope(const PipelineObj *pipeline)
+{
+    std::string format;
+    if (pipeline->format == VertexFormat::Half)
+        format = ", half";
+    else if (pipeline->format == VertexFormat::Snorm16)
+        format = ", snorm16";
+    switch (pipeline->topology)
+    {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return "draws point list" + format;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        return "draws line list" + format;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+        return "draws line strip" + format;
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+        return "draws triangle list" + format;
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+        return "draws triangle strip" + format;
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+        return "draws triangle fan" + format;
+    default:
+        return "draws topology " + std::to_string(pipeline->topology) + format;
+    }
+}
+
+static VkDeviceSize vertexStride(VertexFormat format)
+{
+    return format == VertexFormat::Float32 ? sizeof(Vertex) : sizeof(CompactVertex);
+}
+
+// packs the vertices for a compact format, dequantize is set to the transform the shader positions need
+static std::vector<CompactVertex> packVertices(const Vertex *vertices, uint32_t vertexCount, VertexFormat format,
+                                               glm::mat4 &dequantize)
+{
+    // snorm positions span the bounding box, flat axes keep a scale of 1
+    MeshBounds bounds = computeBounds(vertices, vertexCount);
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+    for (uint32_t i{0}; i < 3; ++i)
+    {
+        extent[i] = extent[i] > 0.0f ? extent[i] : 1.0f;
+    }
+    dequantize = glm::mat4(1.0f);
+    if (format == VertexFormat::Snorm16)
+        dequantize = glm::scale(glm::translate(glm::mat4(1.0f), center), extent);
+
+    std::vector<CompactVertex> packed(vertexCount);
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        glm::vec3 pos = vertices[i].pos;
+        for (uint32_t j{0}; j < 3; ++j)
+        {
+            packed[i].pos[j] = format == VertexFormat::Half ? glm::packHalf1x16(pos[j])
+                                                            : glm::packSnorm1x16((pos[j] - center[j]) / extent[j]);
+        }
+        packed[i].pos[3] = format == VertexFormat::Half ? glm::packHalf1x16(1.0f) : glm::packSnorm1x16(1.0f);
+        packed[i].color = glm::packUnorm4x8(glm::vec4(vertices[i].color, 1.0f));
+    }
+    return packed;
+}
+
+// instance i of an object in the order its instances are drawn, grouped by level of detail
+static const InstanceData &drawnInstance(const SceneObjData &object, uint32_t i)
+{
+    return object.instances[object.lodOrder.empty() ? i : object.lodOrder[i]];
+}
+
+// count drawn instances starting at first as the vertex shader reads them, quantized positions are mapped back
+// before the instance matrix
+static void writeInstances(InstanceData *destination, const SceneObjData &object, const MeshObj &mesh,
+                           uint32_t first, uint32_t count)
 {
-    if (result != VK_SUCCESS)
+    if (mesh.format != VertexFormat::Snorm16 && object.lodOrder.empty())
+    {
+        memcpy(destination, object.instances.data() + first, sizeof(InstanceData) * count);
+        return;
+    }
+    for (uint32_t i{0}; i < count; ++i)
     {
-        throw std::runtime_error(error);
+        const glm::mat4 &model = drawnInstance(object, first + i).model;
+        destination[i].model = mesh.format == VertexFormat::Snorm16 ? model * mesh.dequantize : model;
     }
 }
 
+// levels of detail an object draws, each one from a draw of its own
+static uint32_t objectLevels(const SceneBatchObj &objects, ObjectHandle object, const MeshObj &mesh)
+{
+    return objects.flags[object] & SceneBatchObj::SELECTS_LODS ? mesh.lodCount : 1;
+}
+
+// longest axis of a model matrix
+static float maxScale(const glm::mat4 &model)
+{
+    return std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+                     glm::length(glm::vec3(model[2]))});
+}
+
+// sphere around count drawn instances of a mesh starting at first, in the space of the object's model matrix
+static glm::vec4 instanceBounds(glm::vec4 sphere, const SceneObjData &object, uint32_t first, uint32_t count)
+{
+    glm::vec3 low{std::numeric_limits<float>::max()};
+    glm::vec3 high{std::numeric_limits<float>::lowest()};
+    for (uint32_t i{first}; i < first + count; ++i)
+    {
+        glm::vec3 center = drawnInstance(object, i).model * glm::vec4(glm::vec3(sphere), 1.0f);
+        low = glm::min(low, center);
+        high = glm::max(high, center);
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius{0.0f};
+    for (uint32_t i{first}; i < first + count; ++i)
+    {
+        const glm::mat4 &model = drawnInstance(object, i).model;
+        glm::vec3 instanceCenter = model * glm::vec4(glm::vec3(sphere), 1.0f);
+        radius = std::max(radius, glm::length(instanceCenter - center) + sphere.w * maxScale(model));
+    }
+    return glm::vec4(center, radius);
+}
+
+// indirect draws of an object at most, triangle lists draw every meshlet on its own and every coarser level of
+// detail whole
+static uint32_t objectDraws(const MeshObj &mesh, VkPrimitiveTopology topology)
+{
+    if (topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        return 1;
+    return std::max(mesh.meshletCount, 1u) + mesh.lodCount - 1;
+}
+
+// normal cone of a meshlet in the space of its object, it only holds for a single instance whose model matrix keeps
+// angles
+static glm::vec4 instanceCone(glm::vec4 cone, const std::vector<InstanceData> &instances)
+{
+    glm::vec4 never(0.0f, 0.0f, 0.0f, 1.0f);
+    if (cone.w >= 1.0f || instances.size() != 1)
+        return never;
+    glm::mat3 model(instances[0].model);
+    float scales[3]{glm::length(model[0]), glm::length(model[1]), glm::length(model[2])};
+    if (*std::max_element(scales, scales + 3) > 1.01f * *std::min_element(scales, scales + 3))
+        return never;
+    // mirroring flips the winding and with it the side the triangles face
+    glm::vec3 axis = glm::normalize(model * glm::vec3(cone));
+    return glm::vec4(glm::determinant(model) < 0.0f ? -axis : axis, cone.w);
+}
+
 Graphics::Graphics(VkDevice logDevice, VkPhysicalDevice phyDevice, VkSurfaceKHR surface, VkFormat depthFormat,
-                   VkQueue graphicsQueue, GraphicsInfo inf)
-    : logDevice(logDevice), sc(logDevice, phyDevice, surface, inf.getFrameBufferSize),
-      command(logDevice, phyDevice, inf.framesInFlight, inf.clearValue),
-      pool(logDevice, inf.models.size(), inf.framesInFlight),
-      depth(logDevice, phyDevice, sc.extent, inf.multiSampleCount, depthFormat,
+                   const QueueObj &queues, const DeviceFeatures &features, const GraphicsInfo &inf)
+    : logDevice(logDevice), indirectDraw(inf.indirectDraw && features.drawIndirectFirstInstance),
+      optimizeMeshes(inf.optimizeMeshes),
+      splitMeshlets(inf.splitMeshlets && indirectDraw && !inf.cullShaderLocation.empty()),
+      backFaceCulling(inf.backFaceCulling), headless(surface == VK_NULL_HANDLE), allocator(logDevice, phyDevice),
+      // one offscreen image more than frames in flight keeps the latest finished frame intact until the next draw
+      sc(logDevice, phyDevice, surface, inf.getFrameBufferSize, allocator, inf.offscreenFormat,
+         inf.framesInFlight + 1),
+      command(logDevice, phyDevice, inf.framesInFlight, static_cast<uint32_t>(sc.images.size()), inf.recordThreads,
+              inf.clearValue),
+      upload(logDevice, allocator, queues.transferFamily, queues.transfer, queues.graphicsFamily, queues.graphics,
+             inf.stagingBufferSize),
+      pipelineCache(logDevice, phyDevice, inf.pipelineCacheLocation, features.pipelineCreationFeedback),
+      vertexBuffer(logDevice, allocator, sizeof(Vertex) * VkDeviceSize(inf.maxVertices),
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, inf.maxVertices),
+      indexBuffer(logDevice, allocator, sizeof(uint32_t) * VkDeviceSize(inf.maxIndices),
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, inf.maxIndices),
+      lodRatios(inf.lodRatios.begin(), inf.lodRatios.begin() + std::min<size_t>(inf.lodRatios.size(), maxLods - 1)),
+      lodErrorPixels(inf.lodErrorPixels), lodHysteresis(inf.lodHysteresis),
+      depth(logDevice, allocator, sc.extent, inf.multiSampleCount, depthFormat,
             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT),
-      color(logDevice, phyDevice, sc.extent, inf.multiSampleCount, sc.format,
+      color(logDevice, allocator, sc.extent, inf.multiSampleCount, sc.format,
             VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT),
-      sync(logDevice, inf.framesInFlight), depthFormat(depthFormat)
+      // every frame in flight reads all objects through one set, indirect frames from storage buffers and direct
+      // draws from a uniform ring at dynamic offsets
+      pool(logDevice, 1, inf.framesInFlight,
+           indirectDraw ? std::vector<VkDescriptorType>{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}
+                        : std::vector<VkDescriptorType>{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC}),
+      cameraPool(logDevice, 1, inf.framesInFlight), camera(inf.camera), updateCamera(inf.updateCamera),
+      updateTransforms(inf.updateTransforms), transformWorkers(inf.transformThreads),
+      cpuProfiler(inf.cpuProfiler), sync(logDevice, inf.framesInFlight), offscreenFrames(inf.framesInFlight),
+      frameReady(inf.frameReady),
+      depthFormat(depthFormat), getFrameBufferSize(inf.getFrameBufferSize),
+      multiSampleCount(inf.multiSampleCount), framesInFlight(inf.framesInFlight),
+      maxObjects(std::max<uint32_t>(inf.maxObjects, inf.models.size())),
+      maxDraws(std::max<uint32_t>(inf.maxDraws, maxObjects)),
+      reuseCommandBuffers(inf.reuseCommandBuffers)
 {
-    std::set<VkPrimitiveTopology> requiredTopologies;
+    shaders.push_back(new ShaderObj(logDevice, indirectDraw ? inf.indirectVertShaderLocation : inf.vertShaderLocation,
+                                    VK_SHADER_STAGE_VERTEX_BIT));
+    shaders.push_back(new ShaderObj(logDevice, inf.fragShaderLocation, VK_SHADER_STAGE_FRAGMENT_BIT));
+    initRenderPass(logDevice, inf.multiSampleCount, depthFormat);
+    initFrameBuffers(logDevice, inf.multiSampleCount);
+    transforms.resize(maxObjects);
+    worldMatrices.resize(maxObjects);
+    retiredBuffers.resize(framesInFlight);
+    // created once, draw hands the same function to the pool every frame
+    transformTask = [this](uint32_t task) {
+        uint32_t objectCount = static_cast<uint32_t>(objects.size());
+        transforms.writeMatrices(task * transformChunk, std::min((task + 1) * transformChunk, objectCount),
+                                 transformDestination, transformStride);
+    };
+    command.multiDrawIndirect = features.multiDrawIndirect;
+    command.cpuProfiler = &cpuProfiler;
+    if (features.drawIndirectCount)
+        command.drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(logDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+    if (indirectDraw && !inf.cullShaderLocation.empty())
+        culling = new CullObj(logDevice, queues.computeFamily, queues.compute, framesInFlight, inf.cullShaderLocation,
+                              pipelineCache, command.drawIndexedIndirectCount != nullptr && command.multiDrawIndirect);
+    initCamera(queues);
+    if (indirectDraw)
+        initIndirectFrames(queues);
+    else
+        initUniformRings(phyDevice);
+    if (inf.readbackFrames > 0 && !sc.copySource)
+        throw std::runtime_error("GraphicsInfo::readbackFrames needs a surface supporting transfer source usage");
+    if (inf.readbackFrames > 0)
+        readback = new ReadbackObj(logDevice, phyDevice, allocator, queues.graphicsFamily, inf.readbackFrames,
+                                   sc.format, sc.extent, inf.frameReadback);
+    if (inf.gpuProfiler)
+    {
+        profiler = new GpuProfiler(logDevice, phyDevice, queues.graphicsFamily, framesInFlight,
+                                   inf.gpuProfileLocation);
+        command.profiler = profiler;
+        command.renderPassScope = profiler->scope("render pass");
+    }
+
     for (uint32_t i{0}; i < inf.models.size(); ++i)
     {
-        vertices.push_back(new BufferObj(BufferObj::optimizeForGPU(
-            logDevice, phyDevice, sizeof(inf.models[i].verticesData[0]) * inf.models[i].verticesData.size(),
-            inf.models[i].verticesData.data(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, command, graphicsQueue,
-            static_cast<uint32_t>(inf.models[i].verticesData.size()))));
-        if (!inf.models[i].indicesData.empty())
-            indices.push_back(new BufferObj(BufferObj::optimizeForGPU(
-                logDevice, phyDevice, sizeof(inf.models[i].indicesData[0]) * inf.models[i].indicesData.size(),
-                inf.models[i].indicesData.data(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, command, graphicsQueue,
-                static_cast<uint32_t>(inf.models[i].indicesData.size()))));
-        else
-            indices.push_back(nullptr);
-        requiredTopologies.insert(inf.models[i].topology);
+        MeshHandle mesh = addMesh(inf.models[i].verticesData, inf.models[i].indicesData, VertexFormat::Float32,
+                                  inf.models[i].topology);
+        ObjectHandle object = addObject(mesh, inf.models[i].topology, inf.models[i].updateUBO);
+        setUBO(object, inf.models[i].ubo);
     }
-    ShaderObj vertexShader(logDevice, inf.vertShaderLocation, VK_SHADER_STAGE_VERTEX_BIT);
-    ShaderObj fragmentShader(logDevice, inf.fragShaderLocation, VK_SHADER_STAGE_FRAGMENT_BIT);
-    initRenderPass(logDevice, inf.multiSampleCount, depthFormat);
-    pUniforms.resize(inf.framesInFlight * inf.models.size());
-    uniformMemoryPointers.resize(inf.framesInFlight * inf.models.size());
-    for (uint8_t i{0}; i < inf.framesInFlight * inf.models.size(); ++i)
+    // one submission for every mesh registered up front
+    upload.submit();
+}
+
+MeshHandle Graphics::addMesh(const std::vector<Vertex> &verticesData, const std::vector<uint32_t> &indicesData,
+                             VertexFormat format, VkPrimitiveTopology topology)
+{
+    // meshes without indices get sequential ones, every mesh is drawn indexed from the shared buffers
+    std::vector<uint32_t> sequentialIndices;
+    const std::vector<uint32_t> *indices = &indicesData;
+    if (indicesData.empty())
     {
-        pUniforms[i] =
-            new BufferObj(logDevice, phyDevice, sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        vkMapMemory(logDevice, pUniforms[i]->memory, 0, sizeof(UniformBufferObject), 0, &uniformMemoryPointers[i]);
+        sequentialIndices.resize(verticesData.size());
+        std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0);
+        indices = &sequentialIndices;
     }
-    for (std::set<VkPrimitiveTopology>::iterator it = requiredTopologies.begin(); it != requiredTopologies.end(); ++it)
+    if (optimizeMeshes && topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST && indices->size() % 3 == 0)
     {
-        pipelines.push_back(new PipelineObj(logDevice, renderPass, pool, sc,
-                                            {vertexShader.stageInfo, fragmentShader.stageInfo}, inf.multiSampleCount,
-                                            *it));
+        std::vector<Vertex> optimizedVertices(verticesData);
+        std::vector<uint32_t> optimizedIndices(*indices);
+        optimizeMesh(optimizedVertices, optimizedIndices);
+        return addMesh(optimizedVertices.data(), static_cast<uint32_t>(optimizedVertices.size()),
+                       optimizedIndices.data(), static_cast<uint32_t>(optimizedIndices.size()),
+                       computeBounds(optimizedVertices.data(), static_cast<uint32_t>(optimizedVertices.size())).sphere,
+                       format, topology);
     }
-    initDescriptorSets(logDevice, inf.models.size(), inf.framesInFlight);
-    initFrameBuffers(logDevice, inf.multiSampleCount);
+    return addMesh(verticesData.data(), static_cast<uint32_t>(verticesData.size()), indices->data(),
+                   static_cast<uint32_t>(indices->size()),
+                   computeBounds(verticesData.data(), static_cast<uint32_t>(verticesData.size())).sphere, format,
+                   topology);
+}
+
+MeshHandle Graphics::addMesh(const MeshFileObj &mesh, VertexFormat format, VkPrimitiveTopology topology)
+{
+    // the triangles of an optimized file no longer form the strips or point order of the source
+    if ((mesh.header.flags & MeshFileHeader::TRIANGLE_ORDER) && topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        throw std::runtime_error("mesh file was optimized for triangle lists, add it with that topology");
+    return addMesh(mesh.vertices, mesh.header.vertexCount, mesh.indices, mesh.header.indexCount, mesh.header.sphere,
+                   format, topology);
+}
+
+MeshHandle Graphics::addMesh(const Vertex *verticesData, uint32_t meshVertexCount, const uint32_t *indicesData,
+                             uint32_t meshIndexCount, glm::vec4 bounds, VertexFormat format,
+                             VkPrimitiveTopology topology)
+{
+    // meshes of every format share the buffers, each one starts at a multiple of its vertex and index size
+    VkDeviceSize stride = vertexStride(format);
+    VkIndexType indexType = meshVertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    VkDeviceSize vertexStart = (vertexBytes + stride - 1) / stride * stride;
+    VkDeviceSize indexStart = (indexBytes + indexSize - 1) / indexSize * indexSize;
+    if (stride * meshVertexCount > sizeof(Vertex) * VkDeviceSize(vertexBuffer.Count) - vertexStart)
+        throw std::runtime_error("exceeded GraphicsInfo::maxVertices");
+
+    // the triangles of every meshlet are uploaded consecutively, reordering them is only safe for meshes never drawn
+    // with another topology
+    bool triangleList = topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST && meshIndexCount % 3 == 0;
+    std::vector<uint32_t> meshletIndices;
+    std::vector<Meshlet> meshMeshlets;
+    if (splitMeshlets && triangleList)
+    {
+        meshletIndices.assign(indicesData, indicesData + meshIndexCount);
+        meshMeshlets = buildMeshlets(verticesData, meshVertexCount, meshletIndices);
+        indicesData = meshletIndices.data();
+    }
+
+    // the indices of the coarser levels follow the ones of the mesh, every level is simplified from the one before
+    // down to its fraction of the triangles and errors add up along the way, up to maxLods - 1 of them
+    std::vector<MeshLod> meshLods{{0, meshIndexCount, 0.0f}};
+    std::vector<uint32_t> lodIndices;
+    if (!lodRatios.empty() && triangleList)
+    {
+        lodIndices.assign(indicesData, indicesData + meshIndexCount);
+        for (uint32_t i{0}; i < lodRatios.size(); ++i)
+        {
+            MeshLod finer = meshLods.back();
+            std::vector<uint32_t> finerIndices(lodIndices.begin() + finer.firstIndex,
+                                               lodIndices.begin() + finer.firstIndex + finer.indexCount);
+            float error;
+            std::vector<uint32_t> levelIndices =
+                simplifyMesh(verticesData, meshVertexCount, finerIndices,
+                             static_cast<uint32_t>(lodRatios[i] * meshIndexCount) / 3 * 3, error);
+            if (levelIndices.empty() || levelIndices.size() == finerIndices.size())
+                break;
+            if (optimizeMeshes)
+                optimizeVertexCache(levelIndices, meshVertexCount);
+            meshLods.push_back({
+                .firstIndex = static_cast<uint32_t>(lodIndices.size()),
+                .indexCount = static_cast<uint32_t>(levelIndices.size()),
+                .error = finer.error + error,
+            });
+            lodIndices.insert(lodIndices.end(), levelIndices.begin(), levelIndices.end());
+        }
+        indicesData = lodIndices.data();
+    }
+    uint32_t totalIndexCount = meshLods.back().firstIndex + meshLods.back().indexCount;
+    if (indexSize * totalIndexCount > sizeof(uint32_t) * VkDeviceSize(indexBuffer.Count) - indexStart)
+        throw std::runtime_error("exceeded GraphicsInfo::maxIndices");
+
+    glm::mat4 dequantize(1.0f);
+    std::vector<CompactVertex> packedVertices;
+    const void *vertexData = verticesData;
+    if (format != VertexFormat::Float32)
+    {
+        packedVertices = packVertices(verticesData, meshVertexCount, format, dequantize);
+        vertexData = packedVertices.data();
+    }
+
+    // 16 bit indices are narrowed on their way into the staging ring, the indices of a mapped file are read once
+    auto writeIndices = [&](void *staging, VkDeviceSize offset, VkDeviceSize chunk) {
+        const uint32_t *source = indicesData + offset / indexSize;
+        if (indexType == VK_INDEX_TYPE_UINT32)
+        {
+            memcpy(staging, source, (size_t)chunk);
+            return;
+        }
+        uint16_t *shortIndices = static_cast<uint16_t *>(staging);
+        for (VkDeviceSize i{0}; i < chunk / indexSize; ++i)
+        {
+            shortIndices[i] = static_cast<uint16_t>(source[i]);
+        }
+    };
+
+    // the copies join the batch being recorded, it is submitted with the next frame
+    upload.enqueue(vertexBuffer.buffer, vertexStart, vertexData, stride * meshVertexCount);
+    MeshObj mesh{
+        .vertexOffset = static_cast<int32_t>(vertexStart / stride),
+        .firstIndex = static_cast<uint32_t>(indexStart / indexSize),
+        .indexCount = meshIndexCount,
+        .bounds = bounds,
+        .format = format,
+        .indexType = indexType,
+        .topology = topology,
+        .dequantize = dequantize,
+        .firstMeshlet = static_cast<uint32_t>(meshlets.size()),
+        .meshletCount = static_cast<uint32_t>(meshMeshlets.size()),
+        .firstLod = static_cast<uint32_t>(lods.size()),
+        .lodCount = static_cast<uint32_t>(meshLods.size()),
+        // tickets only grow, the index upload covers both copies
+        .uploadTicket = upload.enqueue(indexBuffer.buffer, indexStart, indexSize * totalIndexCount, writeIndices),
+    };
+    vertexBytes = vertexStart + stride * meshVertexCount;
+    indexBytes = indexStart + indexSize * totalIndexCount;
+    pendingMeshes++;
+    meshes.push_back(mesh);
+    meshlets.insert(meshlets.end(), meshMeshlets.begin(), meshMeshlets.end());
+    lods.insert(lods.end(), meshLods.begin(), meshLods.end());
+    return static_cast<MeshHandle>(meshes.size() - 1);
+}
+
+uint32_t SceneBatchObj::size() const
+{
+    return static_cast<uint32_t>(meshes.size());
+}
+
+ObjectHandle SceneBatchObj::push()
+{
+    meshes.push_back(0);
+    pipelines.push_back(nullptr);
+    bounds.push_back(glm::vec4(0.0f));
+    instanceCounts.push_back(0);
+    lodInstances.resize(lodInstances.size() + maxLods, 0);
+    staleFrames.push_back(0);
+    flags.push_back(0);
+    ubos.push_back({});
+    cold.emplace_back();
+    return size() - 1;
+}
+
+ObjectHandle Graphics::addObject(MeshHandle mesh, VkPrimitiveTopology topology,
+                                 std::function<void(UniformBufferObject &ubo, SwapChainObj &sc)> updateUBO)
+{
+    if (objects.size() == maxObjects && freeObjects.empty())
+        throw std::runtime_error("exceeded GraphicsInfo::maxObjects");
+    if (meshes[mesh].topology != anyTopology && meshes[mesh].topology != topology)
+        throw std::runtime_error("drew a mesh with another topology than the one it was added with");
+    uint32_t draws = objectDraws(meshes[mesh], topology);
+    if (indirectDraw && draws > maxDraws - drawCount)
+        throw std::runtime_error("exceeded GraphicsInfo::maxDraws");
+
+    PipelineObj *pipeline{nullptr};
+    for (uint32_t i{0}; i < pipelines.size(); ++i)
+    {
+        if (pipelines[i]->topology == topology && pipelines[i]->format == meshes[mesh].format)
+            pipeline = pipelines[i];
+    }
+    if (pipeline == nullptr)
+    {
+        pipeline = new PipelineObj(logDevice, renderPass, cameraPool, pool, sc,
+                                   {shaders[0]->stageInfo, shaders[1]->stageInfo}, multiSampleCount, topology,
+                                   meshes[mesh].format, backFaceCulling ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE,
+                                   pipelineCache);
+        pipelines.push_back(pipeline);
+        if (profiler != nullptr)
+            pipeline->profilerScope = profiler->scope(drawScope(pipeline));
+    }
+    drawCount += draws;
+    // recorded direct draws hold every object, indirect frames write the new one into a free range
+    if (!indirectDraw)
+        sceneVersion++;
+    else
+        reserveInstances(++indirectInstances);
+
+    ObjectHandle handle;
+    if (!freeObjects.empty())
+    {
+        // removed slots keep their instance buffers
+        handle = freeObjects.back();
+        freeObjects.pop_back();
+    }
+    else
+    {
+        handle = objects.push();
+        // indirect frames keep every object in their shared storage buffers
+        for (uint32_t i{0}; !indirectDraw && i < framesInFlight; ++i)
+        {
+            pInstances.push_back(
+                new BufferObj(logDevice, allocator, sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1));
+        }
+    }
+    // a single instance at the origin of the object is bounded by the mesh
+    objects.meshes[handle] = mesh;
+    objects.pipelines[handle] = pipeline;
+    objects.bounds[handle] = meshes[mesh].bounds;
+    objects.instanceCounts[handle] = 1;
+    objects.staleFrames[handle] = framesInFlight;
+    objects.flags[handle] = updateUBO ? SceneBatchObj::UPDATES_UBO : uint8_t{0};
+    objects.ubos[handle] = {};
+    objects.cold[handle] = {
+        .updateUBO = updateUBO,
+        .instances = {InstanceData{}},
+    };
+    resetLods(handle);
+    if (indirectDraw)
+        placeIndirectObject(handle);
+    else
+        growInstanceBuffers(handle);
+    return handle;
+}
+
+void Graphics::removeObject(ObjectHandle object)
+{
+    // a second removal would hand the slot out twice
+    if (objects.pipelines[object] == nullptr)
+        throw std::runtime_error("removed an object that was already removed");
+    uint32_t draws = objectDraws(meshes[objects.meshes[object]], objects.pipelines[object]->topology);
+    drawCount -= draws;
+    indirectInstances -= objects.instanceCounts[object];
+    transformedObjects -= (objects.flags[object] & SceneBatchObj::TRANSFORMED) != 0;
+    objects.pipelines[object] = nullptr;
+    objects.flags[object] = 0;
+    objects.cold[object].updateUBO = nullptr;
+    // the next object in this slot starts out as the identity
+    transforms.detach(object);
+    transforms.set(object, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    freeObjects.push_back(object);
+    // every indirect frame clears the commands of the object once, its instances are left until the next layout
+    if (indirectDraw)
+        freeCommands.push_back({
+            .batch = indirectSlots[object].batch,
+            .first = indirectSlots[object].firstCommand,
+            .count = draws,
+            .staleFrames = framesInFlight,
+        });
+    else
+        sceneVersion++;
+}
+
+void Graphics::setUBO(ObjectHandle object, const UniformBufferObject &ubo)
+{
+    objects.ubos[object] = ubo;
+}
+
+void Graphics::setCamera(const CameraData &camera)
+{
+    this->camera = camera;
+}
+
+void Graphics::setTransform(ObjectHandle object, glm::vec3 translation, glm::quat rotation, glm::vec3 scale)
+{
+    transforms.set(object, translation, rotation, scale);
+    markTransformed(object);
+}
+
+void Graphics::setParent(ObjectHandle object, ObjectHandle parent)
+{
+    transforms.setParent(object, parent);
+    markTransformed(object);
+    if (parent != noParent)
+        markTransformed(parent);
+}
+
+void Graphics::markTransformed(ObjectHandle object)
+{
+    transformedObjects += (objects.flags[object] & SceneBatchObj::TRANSFORMED) == 0;
+    objects.flags[object] |= SceneBatchObj::TRANSFORMED;
+}
+
+glm::mat4 Graphics::objectModel(ObjectHandle object)
+{
+    if ((objects.flags[object] & SceneBatchObj::TRANSFORMED) == 0)
+        return objects.ubos[object].model;
+    return transforms.childSlots > 0 ? worldMatrices[object] : transforms.matrix(object);
+}
+
+TransformBatchObj &Graphics::getTransforms()
+{
+    return transforms;
+}
+
+void Graphics::setInstances(ObjectHandle object, const std::vector<InstanceData> &instances)
+{
+    // the instance buffers of frames still in flight are refreshed once draw gets to them
+    uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+    indirectInstances += instanceCount - objects.instanceCounts[object];
+    objects.cold[object].instances = instances;
+    objects.instanceCounts[object] = instanceCount;
+    objects.staleFrames[object] = framesInFlight;
+    resetLods(object);
+    objects.bounds[object] = instanceBounds(meshes[objects.meshes[object]].bounds, objects.cold[object], 0,
+                                            instanceCount);
+    if (indirectDraw)
+    {
+        // instances that no longer fit the range of the object move behind the used ones
+        reserveInstances(indirectInstances);
+        if (instanceCount > indirectSlots[object].instanceCapacity && !allocateInstances(object, instanceCount))
+            layoutIndirectDraws();
+        return;
+    }
+    // recorded direct draws bind the levels of detail at offsets that follow the instance count
+    sceneVersion++;
+    growInstanceBuffers(object);
+}
+
+void Graphics::growInstanceBuffers(ObjectHandle object)
+{
+    // buffers grow here so draw never allocates, frames in flight keep reading the old ones until draw retires them,
+    // every level of detail has room for all instances of the object
+    uint32_t instanceCount =
+        objects.instanceCounts[object] * objectLevels(objects, object, meshes[objects.meshes[object]]);
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        BufferObj *&instanceBuffer = pInstances[i + framesInFlight * object];
+        if (instanceCount <= instanceBuffer->Count)
+            continue;
+        uint32_t capacity = std::max(instanceCount, instanceBuffer->Count * 2);
+        retiredBuffers[i].push_back(instanceBuffer);
+        instanceBuffer = new BufferObj(logDevice, allocator, sizeof(InstanceData) * VkDeviceSize(capacity),
+                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       capacity);
+    }
+}
+
+void Graphics::reserveInstances(uint32_t instanceCount)
+{
+    // the descriptors of a frame in flight can not be written, draw swaps the grown buffers in after its fence and
+    // records the frame again as it binds them
+    if (instanceCount <= instanceCapacity)
+        return;
+    instanceCapacity = std::max(instanceCount, instanceCapacity * 2);
+    sceneVersion++;
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        // grown buffers never drawn from are replaced right away
+        delete indirectFrames[i].grownInstances;
+        delete indirectFrames[i].grownInstanceObjects;
+        indirectFrames[i].grownInstances =
+            new BufferObj(logDevice, allocator, sizeof(InstanceData) * VkDeviceSize(instanceCapacity),
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, hostVisible, instanceCapacity);
+        indirectFrames[i].grownInstanceObjects =
+            new BufferObj(logDevice, allocator, sizeof(uint32_t) * VkDeviceSize(instanceCapacity),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, instanceCapacity);
+    }
+}
+
+bool Graphics::allocateInstances(ObjectHandle object, uint32_t instanceCount)
+{
+    if (instanceCount > instanceCapacity - indirectInstanceEnd)
+        return false;
+    indirectSlots[object].firstInstance = indirectInstanceEnd;
+    indirectSlots[object].instanceCapacity = instanceCount;
+    indirectInstanceEnd += instanceCount;
+    return true;
+}
+
+void Graphics::placeIndirectObject(ObjectHandle object)
+{
+    // first fit into the free commands of the batch of the object, the draws are only laid out again once none of
+    // them has room or the object starts a batch of its own
+    const MeshObj &mesh = meshes[objects.meshes[object]];
+    uint32_t draws = objectDraws(mesh, objects.pipelines[object]->topology);
+    if (object >= indirectSlots.size())
+        indirectSlots.resize(object + 1);
+    for (uint32_t i{0}; i < freeCommands.size(); ++i)
+    {
+        IndirectRange &range = freeCommands[i];
+        const IndirectBatch &batch = indirectBatches[range.batch];
+        if (batch.pipeline != objects.pipelines[object] || batch.indexType != mesh.indexType || range.count < draws)
+            continue;
+        if (!allocateInstances(object, objects.instanceCounts[object]))
+            break;
+        indirectSlots[object].batch = range.batch;
+        indirectSlots[object].firstCommand = range.first;
+        range.first += draws;
+        range.count -= draws;
+        if (range.count == 0)
+        {
+            range = freeCommands.back();
+            freeCommands.pop_back();
+        }
+        return;
+    }
+    layoutIndirectDraws();
+}
+
+uint64_t Graphics::getSubmittedTriangles()
+{
+    return submittedTriangles;
+}
+
+void Graphics::resetLods(ObjectHandle object)
+{
+    // every instance starts out at full detail, objects drawing a single level keep no order
+    SceneObjData &data = objects.cold[object];
+    uint32_t *lodInstances = &objects.lodInstances[maxLods * object];
+    uint32_t instanceCount = objects.instanceCounts[object];
+    const PipelineObj *pipeline = objects.pipelines[object];
+    std::fill(lodInstances, lodInstances + maxLods, 0);
+    lodInstances[0] = instanceCount;
+    data.lodOrder.clear();
+    data.instanceLods.clear();
+    objects.flags[object] &= ~SceneBatchObj::SELECTS_LODS;
+    if (pipeline == nullptr || meshes[objects.meshes[object]].lodCount < 2 ||
+        pipeline->topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        return;
+    objects.flags[object] |= SceneBatchObj::SELECTS_LODS;
+    data.lodOrder.resize(instanceCount);
+    std::iota(data.lodOrder.begin(), data.lodOrder.end(), 0);
+    data.instanceLods.assign(instanceCount, 0);
+}
+
+// every instance is drawn at the coarsest level whose error covers at most lodErrorPixels on screen, a level only
+// gets coarser once its error undercuts that by a fraction of lodHysteresis so instances near the boundary do not
+// switch back and forth, returns whether any instance changed its level
+bool Graphics::selectLods(ObjectHandle object, const glm::mat4 &objectModel)
+{
+    SceneObjData &data = objects.cold[object];
+    uint32_t *lodInstances = &objects.lodInstances[maxLods * object];
+    const MeshObj &mesh = meshes[objects.meshes[object]];
+    const MeshLod *levels = &lods[mesh.firstLod];
+    // pixels a length of one covers at a distance of one, perspective projections divide them by the distance
+    float unitPixels = std::abs(camera.proj[1][1]) * 0.5f * static_cast<float>(sc.extent.height);
+    bool perspective = camera.proj[2][3] != 0.0f;
+    glm::mat4 modelView = camera.view * objectModel;
+    float objectScale = maxScale(objectModel);
+    float coarsenPixels = lodErrorPixels * (1.0f - lodHysteresis);
+
+    bool changed{false};
+    for (uint32_t i{0}; i < data.instances.size(); ++i)
+    {
+        const glm::mat4 &model = data.instances[i].model;
+        float scale = objectScale * maxScale(model);
+        float pixels = unitPixels * scale; // per unit of the mesh
+        uint32_t level = mesh.lodCount - 1;
+        if (perspective)
+        {
+            glm::vec3 center = modelView * (model * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+            float distance = glm::length(center) - mesh.bounds.w * scale;
+            if (distance > 0.0f)
+                pixels /= distance;
+            else
+                level = 0;
+        }
+        // errors only grow with the level
+        uint32_t current = data.instanceLods[i];
+        while (level > 0 && levels[level].error * pixels > (level > current ? coarsenPixels : lodErrorPixels))
+        {
+            level--;
+        }
+        changed |= level != current;
+        data.instanceLods[i] = static_cast<uint8_t>(level);
+    }
+    if (!changed)
+        return false;
+
+    // counting sort of the instances by level
+    uint32_t offsets[maxLods]{};
+    std::fill(lodInstances, lodInstances + maxLods, 0);
+    for (uint32_t i{0}; i < data.instances.size(); ++i)
+    {
+        lodInstances[data.instanceLods[i]]++;
+    }
+    for (uint32_t i{1}; i < maxLods; ++i)
+    {
+        offsets[i] = offsets[i - 1] + lodInstances[i - 1];
+    }
+    for (uint32_t i{0}; i < data.instances.size(); ++i)
+    {
+        data.lodOrder[offsets[data.instanceLods[i]]++] = i;
+    }
+    return true;
 }
 
 void Graphics::initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSampleCount, VkFormat depthFormat)
 {
+    // offscreen frames are left ready to be copied out
+    VkImageLayout finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     VkAttachmentDescription color{
         .format = sc.format,
         .samples = multiSampleCount,
@@ -71,7 +766,7 @@ void Graphics::initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSam
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .finalLayout = multiSampleCount != VK_SAMPLE_COUNT_1_BIT ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-                                                                 : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                                 : finalLayout,
     };
     VkAttachmentReference colorRef{
         .attachment = 0,
@@ -100,7 +795,7 @@ void Graphics::initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSam
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .finalLayout = finalLayout,
     };
     VkAttachmentReference colorRefResolve{
         .attachment = 2,
@@ -114,12 +809,22 @@ void Graphics::initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSam
         .pResolveAttachments = multiSampleCount != VK_SAMPLE_COUNT_1_BIT ? &colorRefResolve : nullptr,
         .pDepthStencilAttachment = &depthRef,
     };
+    // offscreen images are not guarded by an acquire semaphore, the dependency also orders their reuse after the
+    // earlier frame drawing to them and after copies out of them
+    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    VkAccessFlags srcAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    if (headless)
+    {
+        srcStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        srcAccess |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
     VkSubpassDependency dependency{
         .srcSubpass = VK_SUBPASS_EXTERNAL,
         .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcStageMask = srcStages,
         .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .srcAccessMask = srcAccess,
         .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
     };
 
@@ -139,21 +844,77 @@ void Graphics::initRenderPass(VkDevice logDevice, VkSampleCountFlagBits multiSam
     vkCheck(vkCreateRenderPass(logDevice, &renderPassInfo, nullptr, &renderPass), "failed to create RenderPass");
 }
 
-void Graphics::initDescriptorSets(VkDevice logDevice, uint32_t modelSize, uint32_t fIF)
+void Graphics::initCamera(const QueueObj &queues)
 {
-    std::vector<VkDescriptorSetLayout> layouts(fIF * modelSize, pool.descriptorlayout);
+    // culling reads the camera on the compute queue
+    std::vector<uint32_t> cullFamilies;
+    if (culling != nullptr)
+        cullFamilies = {queues.graphicsFamily, queues.computeFamily};
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, cameraPool.descriptorlayout);
+    VkDescriptorSetAllocateInfo dInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = cameraPool.descriptorPool,
+        .descriptorSetCount = framesInFlight,
+        .pSetLayouts = layouts.data(),
+    };
+    cameraSets.resize(framesInFlight);
+    vkCheck(vkAllocateDescriptorSets(logDevice, &dInfo, cameraSets.data()), "failed to allocate descriptor sets");
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        cameraBuffers.push_back(new BufferObj(logDevice, allocator, sizeof(CameraData),
+                                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                              0, cullFamilies));
+        VkDescriptorBufferInfo bufferInfo{
+            .buffer = cameraBuffers[i]->buffer,
+            .offset = 0,
+            .range = sizeof(CameraData),
+        };
+        VkWriteDescriptorSet descriptorWrite{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cameraSets[i],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &bufferInfo,
+        };
+        vkUpdateDescriptorSets(logDevice, 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+void Graphics::initUniformRings(VkPhysicalDevice phyDevice)
+{
+    // every object slot starts at a multiple of the alignment dynamic offsets need, a power of two
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    uniformStride = static_cast<uint32_t>((sizeof(UniformBufferObject) + alignment - 1) & ~(alignment - 1));
+
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, pool.descriptorlayout);
     VkDescriptorSetAllocateInfo dInfo{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
         .descriptorPool = pool.descriptorPool,
-        .descriptorSetCount = fIF * modelSize,
+        .descriptorSetCount = framesInFlight,
         .pSetLayouts = layouts.data(),
     };
-    descriptorSets.resize(fIF * modelSize);
+    descriptorSets.resize(framesInFlight);
     vkCheck(vkAllocateDescriptorSets(logDevice, &dInfo, descriptorSets.data()), "failed to allocate descriptor sets");
-    for (uint32_t i{0}; i < fIF * modelSize; ++i)
+    for (uint32_t i{0}; i < framesInFlight; ++i)
     {
+        uniformRings.push_back(new BufferObj(logDevice, allocator, VkDeviceSize(uniformStride) * maxObjects,
+                                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             maxObjects));
+        levelDraws.push_back(new BufferObj(logDevice, allocator,
+                                           sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(maxLods) * maxObjects,
+                                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           maxLods * maxObjects));
         VkDescriptorBufferInfo bufferInfo{
-            .buffer = pUniforms[i]->buffer,
+            .buffer = uniformRings[i]->buffer,
             .offset = 0,
             .range = sizeof(UniformBufferObject),
         };
@@ -163,12 +924,302 @@ void Graphics::initDescriptorSets(VkDevice logDevice, uint32_t modelSize, uint32
             .dstBinding = 0,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .pBufferInfo = &bufferInfo,
         };
         vkUpdateDescriptorSets(logDevice, 1, &descriptorWrite, 0, nullptr);
     }
-};
+}
+
+void Graphics::initIndirectFrames(const QueueObj &queues)
+{
+    indirectFrames.resize(framesInFlight);
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, pool.descriptorlayout);
+    std::vector<VkDescriptorSet> sets(framesInFlight);
+    VkDescriptorSetAllocateInfo dInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool.descriptorPool,
+        .descriptorSetCount = framesInFlight,
+        .pSetLayouts = layouts.data(),
+    };
+    vkCheck(vkAllocateDescriptorSets(logDevice, &dInfo, sets.data()), "failed to allocate descriptor sets");
+
+    // the buffers culling reads on the compute queue are shared with the graphics queue
+    std::vector<uint32_t> cullFamilies;
+    if (culling != nullptr)
+        cullFamilies = {queues.graphicsFamily, queues.computeFamily};
+    auto hostBuffer = [&](VkDeviceSize elementSize, VkBufferUsageFlags usage, uint32_t count,
+                          const std::vector<uint32_t> &queueFamilies = {}) {
+        return new BufferObj(logDevice, allocator, elementSize * count, usage,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, count,
+                             queueFamilies);
+    };
+    instanceCapacity = maxObjects;
+    indirectBatches.reserve(maxObjects);
+    indirectSlots.reserve(maxObjects);
+    freeCommands.reserve(maxObjects);
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        // every batch holds at least one object
+        indirectFrames[i].commands = hostBuffer(sizeof(VkDrawIndexedIndirectCommand),
+                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, maxDraws, cullFamilies);
+        indirectFrames[i].counts = hostBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, maxObjects);
+        indirectFrames[i].objectData =
+            hostBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, maxObjects, cullFamilies);
+        indirectFrames[i].instances = hostBuffer(sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, maxObjects);
+        indirectFrames[i].instanceObjects =
+            hostBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, maxObjects);
+        indirectFrames[i].camera = cameraBuffers[i];
+        indirectFrames[i].descriptorSet = sets[i];
+        indirectFrames[i].batches.reserve(maxObjects);
+        writeIndirectDescriptors(i);
+        if (culling == nullptr)
+            continue;
+
+        // written by the compute queue and read by the graphics queue
+        indirectFrames[i].bounds =
+            hostBuffer(sizeof(DrawBounds), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, maxDraws, cullFamilies);
+        indirectFrames[i].culledCommands = new BufferObj(
+            logDevice, allocator, sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(maxDraws),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, maxDraws, {queues.graphicsFamily, queues.computeFamily});
+        indirectFrames[i].culledCounts = new BufferObj(
+            logDevice, allocator, sizeof(uint32_t) * VkDeviceSize(maxObjects),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, maxObjects, {queues.graphicsFamily, queues.computeFamily});
+        culling->bind(i, indirectFrames[i]);
+    }
+}
+
+void Graphics::writeIndirectDescriptors(uint32_t frame)
+{
+    IndirectFrameObj &indirect = indirectFrames[frame];
+    VkDescriptorBufferInfo bufferInfos[2]{
+        {
+            .buffer = indirect.objectData->buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = indirect.instanceObjects->buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+    };
+    VkWriteDescriptorSet descriptorWrites[2];
+    for (uint32_t i{0}; i < 2; ++i)
+    {
+        descriptorWrites[i] = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = indirect.descriptorSet,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfos[i],
+        };
+    }
+    vkUpdateDescriptorSets(logDevice, 2, descriptorWrites, 0, nullptr);
+}
+
+void Graphics::updateIndirectFrame(uint32_t frame)
+{
+    IndirectFrameObj &indirect = indirectFrames[frame];
+    if (indirect.grownInstances != nullptr)
+    {
+        // the fence of this frame was waited on, none of its buffers is read anymore
+        delete indirect.instances;
+        delete indirect.instanceObjects;
+        indirect.instances = indirect.grownInstances;
+        indirect.instanceObjects = indirect.grownInstanceObjects;
+        indirect.grownInstances = nullptr;
+        indirect.grownInstanceObjects = nullptr;
+        writeIndirectDescriptors(frame);
+    }
+    VkDrawIndexedIndirectCommand *commands =
+        static_cast<VkDrawIndexedIndirectCommand *>(indirect.commands->memory.mapped);
+    bool rebuilt = indirect.version != sceneVersion;
+    if (rebuilt)
+    {
+        // commands outside the ranges of the objects draw nothing
+        memset(commands, 0, sizeof(VkDrawIndexedIndirectCommand) * indirectCommands);
+        uint32_t *counts = static_cast<uint32_t *>(indirect.counts->memory.mapped);
+        for (uint32_t i{0}; i < indirectBatches.size(); ++i)
+        {
+            counts[i] = indirectBatches[i].commandCount;
+        }
+        indirect.batches.assign(indirectBatches.begin(), indirectBatches.end());
+        indirect.commandCount = indirectCommands;
+        indirect.version = sceneVersion;
+    }
+    for (uint32_t i{0}; i < freeCommands.size(); ++i)
+    {
+        if (freeCommands[i].staleFrames == 0)
+            continue;
+        if (!rebuilt)
+            memset(commands + freeCommands[i].first, 0, sizeof(VkDrawIndexedIndirectCommand) * freeCommands[i].count);
+        freeCommands[i].staleFrames--;
+    }
+    // the ranges stay where they are, only objects added or whose mesh, instances or levels of detail changed are
+    // written again
+    for (uint32_t i{0}; i < objects.size(); ++i)
+    {
+        if (objects.pipelines[i] != nullptr && (rebuilt || objects.staleFrames[i] > 0))
+            writeIndirectObject(indirect, i);
+        if (objects.staleFrames[i] > 0)
+            objects.staleFrames[i]--;
+    }
+}
+
+void Graphics::layoutIndirectDraws()
+{
+    // objects sharing a pipeline and index type get consecutive commands, every object keeps one command per
+    // meshlet and coarser level of detail whether they draw instances or not
+    //
+    // the instances are packed into at most half of the buffers and every batch ends in up to as many free commands
+    // as its objects take, added objects and instances fill those for long before the next layout
+    reserveInstances(2 * indirectInstances);
+    const VkIndexType indexTypes[2]{VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32};
+    uint32_t spareCommands = maxDraws - drawCount;
+    uint32_t commandCount{0};
+    uint32_t firstInstance{0};
+    indirectBatches.clear();
+    freeCommands.clear();
+    indirectSlots.resize(objects.size());
+    for (uint32_t p{0}; p < 2 * pipelines.size(); ++p)
+    {
+        IndirectBatch batch{
+            .pipeline = pipelines[p / 2],
+            .indexType = indexTypes[p % 2],
+            .firstCommand = commandCount,
+            .commandCount = 0,
+        };
+        for (uint32_t i{0}; i < objects.size(); ++i)
+        {
+            const MeshObj &mesh = meshes[objects.meshes[i]];
+            if (objects.pipelines[i] != batch.pipeline || mesh.indexType != batch.indexType)
+                continue;
+            indirectSlots[i] = {
+                .batch = static_cast<uint32_t>(indirectBatches.size()),
+                .firstCommand = commandCount,
+                .firstInstance = firstInstance,
+                .instanceCapacity = objects.instanceCounts[i],
+            };
+            uint32_t draws = objectDraws(mesh, batch.pipeline->topology);
+            commandCount += draws;
+            batch.commandCount += draws;
+            firstInstance += indirectSlots[i].instanceCapacity;
+            // written into every frame in flight by the full rewrite below
+            objects.staleFrames[i] = 0;
+        }
+        if (batch.commandCount == 0)
+            continue;
+        uint32_t spare = static_cast<uint32_t>(
+            std::min<uint64_t>(batch.commandCount, uint64_t(spareCommands) * batch.commandCount / drawCount));
+        if (spare > 0)
+            freeCommands.push_back({
+                .batch = static_cast<uint32_t>(indirectBatches.size()),
+                .first = commandCount,
+                .count = spare,
+                .staleFrames = 0,
+            });
+        commandCount += spare;
+        batch.commandCount += spare;
+        indirectBatches.push_back(batch);
+    }
+    indirectCommands = commandCount;
+    indirectInstanceEnd = firstInstance;
+    // every frame in flight writes all of its draws again and records its command buffers
+    sceneVersion++;
+}
+
+void Graphics::writeIndirectObject(IndirectFrameObj &indirect, ObjectHandle object)
+{
+    // each command draws the instances of the object at one level of detail or of one of its meshlets, levels
+    // without instances and meshes still uploading draw none
+    const SceneObjData &data = objects.cold[object];
+    const IndirectSlot &slot = indirectSlots[object];
+    const MeshObj &mesh = meshes[objects.meshes[object]];
+    uint32_t instanceCount = objects.instanceCounts[object];
+    VkDrawIndexedIndirectCommand *commands =
+        static_cast<VkDrawIndexedIndirectCommand *>(indirect.commands->memory.mapped);
+    InstanceData *instances = static_cast<InstanceData *>(indirect.instances->memory.mapped);
+    uint32_t *instanceObjects = static_cast<uint32_t *>(indirect.instanceObjects->memory.mapped);
+    DrawBounds *bounds = indirect.bounds != nullptr ? static_cast<DrawBounds *>(indirect.bounds->memory.mapped)
+                                                    : nullptr;
+    bool triangles = objects.pipelines[object]->topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    bool split = mesh.meshletCount > 0 && triangles;
+    uint32_t command = slot.firstCommand;
+    // the instances of every level follow each other, only the mesh itself is split into meshlets
+    uint32_t levelInstance{0};
+    for (uint32_t l{0}; l < (triangles ? mesh.lodCount : 1); ++l)
+    {
+        const MeshLod &lod = lods[mesh.firstLod + l];
+        uint32_t levelInstances = mesh.ready ? objects.lodInstances[maxLods * object + l] : 0;
+        uint32_t draws = l == 0 && split ? mesh.meshletCount : 1;
+        for (uint32_t j{0}; j < draws; ++j, ++command)
+        {
+            // a level drawn whole is a single meshlet that never faces away
+            Meshlet meshlet{lod.firstIndex, lod.indexCount, mesh.bounds, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)};
+            if (l == 0 && split)
+                meshlet = meshlets[mesh.firstMeshlet + j];
+            if (bounds != nullptr && levelInstances > 0)
+            {
+                // a whole level holding every instance is bounded like the object
+                bool whole = levelInstances == instanceCount && !(l == 0 && split);
+                bounds[command] = {
+                    .sphere = whole ? objects.bounds[object]
+                                    : instanceBounds(meshlet.sphere, data, levelInstance, levelInstances),
+                    .cone = backFaceCulling ? instanceCone(meshlet.cone, data.instances)
+                                            : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                    .object = object,
+                    .batch = slot.batch,
+                    .firstCommand = indirectBatches[slot.batch].firstCommand,
+                };
+            }
+            commands[command] = {
+                .indexCount = meshlet.indexCount,
+                .instanceCount = levelInstances,
+                .firstIndex = mesh.firstIndex + meshlet.firstIndex,
+                .vertexOffset = mesh.vertexOffset,
+                .firstInstance = slot.firstInstance + levelInstance,
+            };
+        }
+        levelInstance += levelInstances;
+    }
+    if (!mesh.ready)
+        return;
+    writeInstances(instances + slot.firstInstance, data, mesh, 0, instanceCount);
+    std::fill(instanceObjects + slot.firstInstance, instanceObjects + slot.firstInstance + instanceCount, object);
+}
+
+void Graphics::writeDirectObject(uint32_t frame, ObjectHandle object)
+{
+    // every level of detail draws from a region of the instance buffer of its own, the draws of meshes still
+    // uploading draw no instances
+    const SceneObjData &data = objects.cold[object];
+    const MeshObj &mesh = meshes[objects.meshes[object]];
+    InstanceData *instances =
+        static_cast<InstanceData *>(pInstances[frame + framesInFlight * object]->memory.mapped);
+    VkDrawIndexedIndirectCommand *commands =
+        static_cast<VkDrawIndexedIndirectCommand *>(levelDraws[frame]->memory.mapped) + maxLods * object;
+    uint32_t instanceCount = objects.instanceCounts[object];
+    uint32_t levelInstance{0};
+    for (uint32_t l{0}; l < objectLevels(objects, object, mesh); ++l)
+    {
+        const MeshLod &lod = lods[mesh.firstLod + l];
+        uint32_t levelInstances = objects.lodInstances[maxLods * object + l];
+        writeInstances(instances + instanceCount * l, data, mesh, levelInstance, levelInstances);
+        commands[l] = {
+            .indexCount = lod.indexCount,
+            .instanceCount = mesh.ready ? levelInstances : 0,
+            .firstIndex = mesh.firstIndex + lod.firstIndex,
+            .vertexOffset = mesh.vertexOffset,
+            .firstInstance = 0,
+        };
+        levelInstance += levelInstances;
+    }
+}
 
 void Graphics::initFrameBuffers(VkDevice logDevice, VkSampleCountFlagBits multiSampleCount)
 {
@@ -193,34 +1244,57 @@ void Graphics::initFrameBuffers(VkDevice logDevice, VkSampleCountFlagBits multiS
     }
 }
 
-void Graphics::reinitSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsInfo inf)
+void Graphics::reinitSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface)
 {
+    CpuScope scope(&cpuProfiler, "recreate swapchain");
     vkDeviceWaitIdle(logDevice);
 
     for (uint8_t i{0}; i < frameBuffers.size(); ++i)
     {
         vkDestroyFramebuffer(logDevice, frameBuffers[i], nullptr);
     }
-    sc = SwapChainObj(logDevice, phyDevice, surface, inf.getFrameBufferSize);
-    depth = ImageObj(logDevice, phyDevice, sc.extent, inf.multiSampleCount, depthFormat,
+    // the new swapchain retires the old one, the assignment destroys the old one and its image views
+    sc = SwapChainObj(logDevice, phyDevice, surface, getFrameBufferSize, allocator, sc.format,
+                      static_cast<uint32_t>(sc.images.size()), sc.SwapChain);
+    depth = ImageObj(logDevice, allocator, sc.extent, multiSampleCount, depthFormat,
                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
-    color = ImageObj(logDevice, phyDevice, sc.extent, inf.multiSampleCount, sc.format,
+    color = ImageObj(logDevice, allocator, sc.extent, multiSampleCount, sc.format,
                      VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                      VK_IMAGE_ASPECT_COLOR_BIT);
-    initFrameBuffers(logDevice, inf.multiSampleCount);
+    initFrameBuffers(logDevice, multiSampleCount);
+    command.resize(static_cast<uint32_t>(sc.images.size()));
+    if (readback != nullptr)
+        readback->resize(sc.format, sc.extent);
+    sceneVersion++;
 }
 
-void Graphics::draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsInfo inf, VkQueue graphicsQueue,
-                    VkQueue presentQueue)
+void Graphics::draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, VkQueue graphicsQueue, VkQueue presentQueue)
 {
+    cpuProfiler.beginFrame();
+    uint64_t phase = cpuProfiler.begin();
     vkWaitForFences(logDevice, 1, &sync.processFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-    uint32_t imageIndex;
-    VkResult swapChainImageState = vkAcquireNextImageKHR(
-        logDevice, sc.SwapChain, UINT64_MAX, sync.imageSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    cpuProfiler.end("fence wait", phase);
+    for (uint32_t i{0}; i < retiredBuffers[currentFrame].size(); ++i)
+    {
+        delete retiredBuffers[currentFrame][i];
+    }
+    retiredBuffers[currentFrame].clear();
+    if (profiler != nullptr)
+        profiler->resolve(currentFrame);
+
+    // headless frames take the offscreen images in turn, the one finished by the fence above is handed out first
+    uint32_t imageIndex = static_cast<uint32_t>(frameNumber % sc.images.size());
+    VkResult swapChainImageState{VK_SUCCESS};
+    phase = cpuProfiler.begin();
+    if (headless)
+        retireOffscreenFrame(currentFrame);
+    else
+        swapChainImageState = vkAcquireNextImageKHR(logDevice, sc.SwapChain, UINT64_MAX,
+                                                    sync.imageSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    cpuProfiler.end("acquire", phase);
     if (swapChainImageState == VK_ERROR_OUT_OF_DATE_KHR)
     {
-        reinitSwapChain(phyDevice, surface, inf);
+        reinitSwapChain(phyDevice, surface);
         return;
     }
     else if (swapChainImageState != VK_SUCCESS && swapChainImageState != VK_SUBOPTIMAL_KHR)
@@ -228,33 +1302,168 @@ void Graphics::draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsIn
         throw std::runtime_error("failed to get next SwapChain image");
     }
 
-    std::vector<VkDescriptorSet> requiredDescriptorSets;
-    std::vector<VkPrimitiveTopology> requiredTopologies;
-    for (uint32_t i{0}; i < inf.models.size(); ++i)
+    // everything below runs every frame and must not touch the heap
+    phase = cpuProfiler.begin();
+    if (updateCamera)
+        updateCamera(camera, sc);
+    memcpy(cameraBuffers[currentFrame]->memory.mapped, &camera, sizeof(camera));
+    if (updateTransforms)
+        updateTransforms(transforms, sc);
+    if (transformedObjects > 0)
     {
-        inf.models[i].updateUBO(inf.models[i].ubo, sc);
-        memcpy(uniformMemoryPointers[currentFrame + inf.framesInFlight * i], &inf.models[i].ubo,
-               sizeof(inf.models[i].ubo));
-        requiredDescriptorSets.push_back(descriptorSets[currentFrame + inf.framesInFlight * i]);
-        requiredTopologies.push_back(inf.models[i].topology);
+        // straight into this frame's object data, the slots of objects without a transform get their ubo below,
+        // hierarchies are composed on the host first as mapped memory is slow to read back
+        void *objectData = indirectDraw ? indirectFrames[currentFrame].objectData->memory.mapped
+                                        : uniformRings[currentFrame]->memory.mapped;
+        size_t objectStride = indirectDraw ? sizeof(UniformBufferObject) : uniformStride;
+        bool hierarchy = transforms.childSlots > 0;
+        transformDestination = hierarchy ? worldMatrices.data() : objectData;
+        transformStride = hierarchy ? sizeof(glm::mat4) : objectStride;
+        uint32_t objectCount = static_cast<uint32_t>(objects.size());
+        transformWorkers.run(transformTask, (objectCount + transformChunk - 1) / transformChunk);
+        if (hierarchy)
+        {
+            transforms.composeHierarchy(worldMatrices.data());
+            for (uint32_t i{0}; i < objectCount; ++i)
+            {
+                memcpy(static_cast<char *>(objectData) + objectStride * i, &worldMatrices[i], sizeof(glm::mat4));
+            }
+        }
     }
+    submittedTriangles = 0;
+    // only objects whose flags ask for it reach into their cold data
+    for (uint32_t i{0}; i < objects.size(); ++i)
+    {
+        if (objects.pipelines[i] == nullptr)
+            continue;
+        uint8_t flags = objects.flags[i];
+        if (flags & SceneBatchObj::UPDATES_UBO)
+            objects.cold[i].updateUBO(objects.ubos[i], sc);
+        const MeshObj &mesh = meshes[objects.meshes[i]];
+        if ((flags & SceneBatchObj::SELECTS_LODS) && mesh.ready && selectLods(i, objectModel(i)))
+        {
+            // the instances are drawn in another order, every frame in flight writes them and the draws of the
+            // object again, the recorded command buffers stay as they are
+            objects.staleFrames[i] = framesInFlight;
+        }
+        if (objects.pipelines[i]->topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST && mesh.ready)
+        {
+            const uint32_t *lodInstances = &objects.lodInstances[maxLods * i];
+            for (uint32_t j{0}; j < mesh.lodCount; ++j)
+            {
+                submittedTriangles += uint64_t(lodInstances[j]) * lods[mesh.firstLod + j].indexCount / 3;
+            }
+        }
+        bool transformed = flags & SceneBatchObj::TRANSFORMED;
+        if (indirectDraw)
+        {
+            if (!transformed)
+                memcpy(static_cast<UniformBufferObject *>(indirectFrames[currentFrame].objectData->memory.mapped) + i,
+                       &objects.ubos[i], sizeof(UniformBufferObject));
+            continue;
+        }
+        if (!transformed)
+            memcpy(static_cast<char *>(uniformRings[currentFrame]->memory.mapped) + uniformStride * i,
+                   &objects.ubos[i], sizeof(UniformBufferObject));
+        if (objects.staleFrames[i] > 0)
+        {
+            // the fence above guarantees this frame's buffers are no longer read, setInstances grew them
+            writeDirectObject(currentFrame, i);
+            objects.staleFrames[i]--;
+        }
+    }
+    cpuProfiler.end("update ubo", phase);
     vkResetFences(logDevice, 1, &sync.processFences[currentFrame]);
 
-    vkResetCommandBuffer(command.Buffers[currentFrame], 0);
-    command.record(pipelines, requiredDescriptorSets, vertices, indices, requiredTopologies, renderPass,
-                   frameBuffers[imageIndex], sc, currentFrame);
+    // streamed uploads keep copying on the transfer queue, only finished ones are acquired ahead of this frame
+    phase = cpuProfiler.begin();
+    upload.submit();
+    upload.handoff();
+    for (uint32_t i{0}; pendingMeshes > 0 && i < meshes.size(); ++i)
+    {
+        if (!meshes[i].ready && upload.isReady(meshes[i].uploadTicket))
+        {
+            meshes[i].ready = true;
+            pendingMeshes--;
+            // the draws of its objects are patched in, they drew no instances so far
+            for (uint32_t j{0}; j < objects.size(); ++j)
+            {
+                if (objects.meshes[j] == i)
+                    objects.staleFrames[j] = framesInFlight;
+            }
+        }
+    }
+
+    if (indirectDraw)
+        updateIndirectFrame(currentFrame);
+    cpuProfiler.end("upload", phase);
 
+    // one command buffer per frame in flight and swapchain image, rerecorded only once the scene changed
+    uint32_t buffer = currentFrame * static_cast<uint32_t>(sc.images.size()) + imageIndex;
+    if (!reuseCommandBuffers || command.versions[buffer] != sceneVersion)
+    {
+        CpuScope scope(&cpuProfiler, "record");
+        vkResetCommandBuffer(command.Buffers[buffer], 0);
+        if (indirectDraw)
+            command.recordIndirect(indirectFrames[currentFrame], cameraSets[currentFrame], vertexBuffer.buffer,
+                                   indexBuffer.buffer, renderPass, frameBuffers[imageIndex], sc, buffer,
+                                   currentFrame);
+        else
+            command.record(objects, meshes, pInstances, levelDraws[currentFrame]->buffer, cameraSets[currentFrame],
+                           descriptorSets[currentFrame], uniformStride, vertexBuffer.buffer, indexBuffer.buffer,
+                           renderPass, frameBuffers[imageIndex], sc, buffer, currentFrame);
+        command.versions[buffer] = sceneVersion;
+    }
+
+    // the culled draws are only read once the culling of this frame finished on the compute queue
+    phase = cpuProfiler.begin();
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint32_t waitCount{0};
+    if (!headless)
+    {
+        waitSemaphores[waitCount] = sync.imageSemaphores[currentFrame];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    if (culling != nullptr)
+    {
+        waitSemaphores[waitCount] = culling->cull(currentFrame, indirectFrames[currentFrame]);
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    }
+    if (profiler != nullptr)
+        profiler->submit(currentFrame, buffer);
+    // a captured frame is presented once the copy signals the render semaphore instead
+    uint32_t readbackSlot = readback != nullptr ? readback->reserve() : UINT32_MAX;
     VkSubmitInfo submitInfo{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &sync.imageSemaphores[currentFrame],
-        .pWaitDstStageMask = new VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT),
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waitSemaphores,
+        .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
-        .pCommandBuffers = &command.Buffers[currentFrame],
-        .signalSemaphoreCount = 1,
+        .pCommandBuffers = &command.Buffers[buffer],
+        .signalSemaphoreCount = !headless && readbackSlot == UINT32_MAX ? 1u : 0u,
         .pSignalSemaphores = &sync.renderSemaphores[currentFrame],
     };
     vkCheck(vkQueueSubmit(graphicsQueue, 1, &submitInfo, sync.processFences[currentFrame]), "failed to submit queue");
+    frameNumber++;
+    if (readbackSlot != UINT32_MAX)
+        readback->capture(readbackSlot, graphicsQueue, sc.images[imageIndex],
+                          headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, sc.format,
+                          sc.extent, frameNumber, headless ? VK_NULL_HANDLE : sync.renderSemaphores[currentFrame]);
+    cpuProfiler.end("submit", phase);
+
+    if (headless)
+    {
+        offscreenFrames[currentFrame] = {
+            .image = sc.images[imageIndex],
+            .view = sc.imageViews[imageIndex],
+            .format = sc.format,
+            .extent = sc.extent,
+            .number = frameNumber,
+        };
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return;
+    }
 
     VkPresentInfoKHR presentInfo{
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -264,7 +1473,9 @@ void Graphics::draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsIn
         .pSwapchains = &sc.SwapChain,
         .pImageIndices = &imageIndex,
     };
+    phase = cpuProfiler.begin();
     swapChainImageState = vkQueuePresentKHR(presentQueue, &presentInfo);
+    cpuProfiler.end("present", phase);
     if (swapChainImageState == VK_ERROR_OUT_OF_DATE_KHR || swapChainImageState == VK_SUBOPTIMAL_KHR)
     {
         reinitSC = true;
@@ -276,24 +1487,112 @@ void Graphics::draw(VkPhysicalDevice phyDevice, VkSurfaceKHR surface, GraphicsIn
     if (reinitSC)
     {
         reinitSC = false;
-        reinitSwapChain(phyDevice, surface, inf);
+        reinitSwapChain(phyDevice, surface);
     }
 
-    currentFrame = (currentFrame + 1) % inf.framesInFlight;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Graphics::flushFrames()
+{
+    // the oldest frame in flight is the one draw would reuse next
+    for (uint32_t i{0}; i < framesInFlight; ++i)
+    {
+        uint32_t frame = (currentFrame + i) % framesInFlight;
+        vkWaitForFences(logDevice, 1, &sync.processFences[frame], VK_TRUE, UINT64_MAX);
+        if (profiler != nullptr)
+            profiler->resolve(frame);
+        retireOffscreenFrame(frame);
+    }
+}
+
+void Graphics::waitUploads()
+{
+    upload.wait(upload.submit());
+}
+
+void Graphics::retireOffscreenFrame(uint32_t frame)
+{
+    if (offscreenFrames[frame].number == 0)
+        return;
+    if (frameReady)
+        frameReady(offscreenFrames[frame]);
+    offscreenFrames[frame].number = 0;
+}
+
+MemoryStats Graphics::getMemoryStats()
+{
+    return allocator.getStats();
+}
+
+std::vector<GpuScopeStats> Graphics::getGpuStats()
+{
+    if (profiler == nullptr)
+        return {};
+    return profiler->getStats();
+}
+
+void Graphics::resetGpuStats()
+{
+    if (profiler != nullptr)
+        profiler->resetStats();
+}
+
+CpuProfiler &Graphics::getCpuProfiler()
+{
+    return cpuProfiler;
+}
+
+const PipelineCacheStats &Graphics::getPipelineCacheStats()
+{
+    return pipelineCache.stats;
 }
 
 Graphics::~Graphics()
 {
+    // retire every upload first, handing one off after its buffers are gone would reference freed handles
+    upload.wait(upload.submit());
     vkDeviceWaitIdle(logDevice);
     vkDestroyRenderPass(logDevice, renderPass, nullptr);
-    for (uint32_t i{0}; i < pUniforms.size(); ++i)
+    for (uint32_t i{0}; i < uniformRings.size(); ++i)
+    {
+        delete uniformRings[i];
+        delete levelDraws[i];
+    }
+    for (uint32_t i{0}; i < cameraBuffers.size(); ++i)
+    {
+        delete cameraBuffers[i];
+    }
+    for (uint32_t i{0}; i < pInstances.size(); ++i)
+    {
+        delete pInstances[i];
+    }
+    for (uint32_t i{0}; i < retiredBuffers.size(); ++i)
     {
-        delete pUniforms[i];
+        for (uint32_t j{0}; j < retiredBuffers[i].size(); ++j)
+        {
+            delete retiredBuffers[i][j];
+        }
+    }
+    for (uint32_t i{0}; i < indirectFrames.size(); ++i)
+    {
+        delete indirectFrames[i].commands;
+        delete indirectFrames[i].counts;
+        delete indirectFrames[i].objectData;
+        delete indirectFrames[i].instances;
+        delete indirectFrames[i].instanceObjects;
+        delete indirectFrames[i].grownInstances;
+        delete indirectFrames[i].grownInstanceObjects;
+        delete indirectFrames[i].bounds;
+        delete indirectFrames[i].culledCommands;
+        delete indirectFrames[i].culledCounts;
     }
-    for (uint32_t i{0}; i < vertices.size(); ++i)
+    delete culling;
+    delete readback;
+    delete profiler;
+    for (uint32_t i{0}; i < shaders.size(); ++i)
     {
-        delete vertices[i];
-        delete indices[i];
+        delete shaders[i];
     }
     for (uint8_t i{0}; i < pipelines.size(); ++i)
     {
@@ -335,23 +1634,35 @@ SyncObj::~SyncObj()
     }
 }
 
-PipelineObj::PipelineObj(VkDevice logDevice, VkRenderPass renderPass, DescriptorPoolObj &pool, SwapChainObj &sc,
+PipelineObj::PipelineObj(VkDevice logDevice, VkRenderPass renderPass, DescriptorPoolObj &cameraPool,
+                         DescriptorPoolObj &pool, SwapChainObj &sc,
                          std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos, VkSampleCountFlagBits multi,
-                         VkPrimitiveTopology topology)
-    : logDevice(logDevice), topology(topology)
+                         VkPrimitiveTopology topology, VertexFormat format, VkCullModeFlags cullMode,
+                         PipelineCacheObj &cache)
+    : logDevice(logDevice), topology(topology), format(format)
 {
-    VkVertexInputBindingDescription vertexBindingDescription{
-        .binding = 0,
-        .stride = sizeof(Vertex),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    VkVertexInputBindingDescription vertexBindingDescriptions[2]{
+        {
+            .binding = 0,
+            .stride = static_cast<uint32_t>(vertexStride(format)),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        },
+        {
+            .binding = 1,
+            .stride = sizeof(InstanceData),
+            .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+        },
     };
 
-    std::vector<VkVertexInputAttributeDescription> vertexAttributes = Vertex::getAttributes();
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes =
+        format == VertexFormat::Float32 ? Vertex::getAttributes() : CompactVertex::getAttributes(format);
+    std::vector<VkVertexInputAttributeDescription> instanceAttributes = InstanceData::getAttributes();
+    vertexAttributes.insert(vertexAttributes.end(), instanceAttributes.begin(), instanceAttributes.end());
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
-        .pVertexBindingDescriptions = &vertexBindingDescription,
+        .vertexBindingDescriptionCount = 2,
+        .pVertexBindingDescriptions = vertexBindingDescriptions,
         .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size()),
         .pVertexAttributeDescriptions = vertexAttributes.data(),
     };
@@ -391,7 +1702,7 @@ PipelineObj::PipelineObj(VkDevice logDevice, VkRenderPass renderPass, Descriptor
         .depthClampEnable = VK_FALSE,
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = VK_POLYGON_MODE_FILL,
-        .cullMode = VK_CULL_MODE_NONE,
+        .cullMode = cullMode,
         .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
         .depthBiasEnable = VK_FALSE,
         .lineWidth = 1.0f,
@@ -425,10 +1736,11 @@ PipelineObj::PipelineObj(VkDevice logDevice, VkRenderPass renderPass, Descriptor
         .pAttachments = &colorBlendAttachment,
     };
 
+    VkDescriptorSetLayout setLayouts[2]{cameraPool.descriptorlayout, pool.descriptorlayout};
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts = &pool.descriptorlayout,
+        .setLayoutCount = 2,
+        .pSetLayouts = setLayouts,
     };
     vkCheck(vkCreatePipelineLayout(logDevice, &pipelineLayoutInfo, nullptr, &layout),
             "failed to create pipeline layout");
@@ -449,8 +1761,7 @@ PipelineObj::PipelineObj(VkDevice logDevice, VkRenderPass renderPass, Descriptor
         .renderPass = renderPass,
         .subpass = 0,
     };
-    vkCheck(vkCreateGraphicsPipelines(logDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pl),
-            "failed to create pipeline");
+    pl = cache.createGraphicsPipeline(pipelineInfo);
 }
 
 PipelineObj::~PipelineObj()
@@ -459,31 +1770,38 @@ PipelineObj::~PipelineObj()
     vkDestroyPipelineLayout(logDevice, layout, nullptr);
 }
 
-DescriptorPoolObj::DescriptorPoolObj(VkDevice logDevice, uint32_t modelSize, uint32_t fIF) : logDevice(logDevice)
+DescriptorPoolObj::DescriptorPoolObj(VkDevice logDevice, uint32_t modelSize, uint32_t fIF,
+                                     std::vector<VkDescriptorType> types, VkShaderStageFlags stages)
+    : logDevice(logDevice)
 {
-    VkDescriptorPoolSize poolSize{
-        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount = fIF * modelSize,
-    };
+    std::vector<VkDescriptorPoolSize> poolSizes(types.size());
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(types.size());
+    for (uint32_t i{0}; i < types.size(); ++i)
+    {
+        poolSizes[i] = {
+            .type = types[i],
+            .descriptorCount = fIF * modelSize,
+        };
+        layoutBindings[i] = {
+            .binding = i,
+            .descriptorType = types[i],
+            .descriptorCount = 1,
+            .stageFlags = stages,
+            .pImmutableSamplers = nullptr,
+        };
+    }
     VkDescriptorPoolCreateInfo poolInfo{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .maxSets = fIF * modelSize,
-        .poolSizeCount = 1,
-        .pPoolSizes = &poolSize,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
     };
     vkCheck(vkCreateDescriptorPool(logDevice, &poolInfo, nullptr, &descriptorPool), "failed to create descriptor pool");
 
-    VkDescriptorSetLayoutBinding uboLB{
-        .binding = 0,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount = 1,
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        .pImmutableSamplers = nullptr,
-    };
     VkDescriptorSetLayoutCreateInfo dlInfo{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 1,
-        .pBindings = &uboLB,
+        .bindingCount = static_cast<uint32_t>(layoutBindings.size()),
+        .pBindings = layoutBindings.data(),
     };
     vkCheck(vkCreateDescriptorSetLayout(logDevice, &dlInfo, nullptr, &descriptorlayout),
             "failed to create descriptor set layout");
@@ -495,9 +1813,9 @@ DescriptorPoolObj::~DescriptorPoolObj()
     vkDestroyDescriptorSetLayout(logDevice, descriptorlayout, nullptr);
 }
 
-ImageObj::ImageObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkExtent2D extent, VkSampleCountFlagBits samples,
+ImageObj::ImageObj(VkDevice logDevice, MemoryAllocator &allocator, VkExtent2D extent, VkSampleCountFlagBits samples,
                    VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags imageAspectFlag)
-    : logDevice(logDevice)
+    : logDevice(logDevice), allocator(&allocator)
 {
     VkImageCreateInfo imageInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -515,34 +1833,10 @@ ImageObj::ImageObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkExtent2D ex
     };
     vkCheck(vkCreateImage(logDevice, &imageInfo, nullptr, &image), "failed to create image");
 
-    // find memory type
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(logDevice, image, &memRequirements);
-    uint32_t vbMemoryType;
-    bool vbMemoryTypeFound{false};
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memProperties);
-    for (uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
-    {
-        if ((memRequirements.memoryTypeBits & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ==
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-        {
-            vbMemoryType = i;
-            vbMemoryTypeFound = true;
-        }
-    }
-
-    if (!vbMemoryTypeFound)
-        throw std::runtime_error("failed to find memory type for image");
-
-    VkMemoryAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = vbMemoryType,
-    };
-    vkCheck(vkAllocateMemory(logDevice, &allocInfo, nullptr, &memory), "failed to allocate image memory");
-    vkBindImageMemory(logDevice, image, memory, 0);
+    memory = allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    vkCheck(vkBindImageMemory(logDevice, image, memory.memory, memory.offset), "failed to bind image memory");
 
     VkImageViewCreateInfo viewInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -561,113 +1855,93 @@ ImageObj::ImageObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkExtent2D ex
     vkCheck(vkCreateImageView(logDevice, &viewInfo, nullptr, &view), "failed to create image view");
 }
 
+ImageObj::ImageObj(ImageObj &&other)
+    : image(other.image), memory(other.memory), view(other.view), logDevice(other.logDevice),
+      allocator(other.allocator)
+{
+    other.image = VK_NULL_HANDLE;
+    other.memory = Allocation{};
+    other.view = VK_NULL_HANDLE;
+}
+
+ImageObj &ImageObj::operator=(ImageObj &&other)
+{
+    if (this != &other)
+    {
+        vkDestroyImageView(logDevice, view, nullptr);
+        vkDestroyImage(logDevice, image, nullptr);
+        allocator->free(memory);
+        image = other.image;
+        memory = other.memory;
+        view = other.view;
+        logDevice = other.logDevice;
+        allocator = other.allocator;
+        other.image = VK_NULL_HANDLE;
+        other.memory = Allocation{};
+        other.view = VK_NULL_HANDLE;
+    }
+    return *this;
+}
+
 ImageObj::~ImageObj()
 {
     vkDestroyImageView(logDevice, view, nullptr);
     vkDestroyImage(logDevice, image, nullptr);
-    vkFreeMemory(logDevice, memory, nullptr);
+    allocator->free(memory);
 }
 
-BufferObj::BufferObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize size, VkBufferUsageFlags usage,
-                     VkMemoryPropertyFlags properties, uint32_t count)
-    : Count(count), logDevice(logDevice)
+BufferObj::BufferObj(VkDevice logDevice, MemoryAllocator &allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties, uint32_t count, std::vector<uint32_t> queueFamilies)
+    : Count(count), logDevice(logDevice), allocator(&allocator)
 {
+    std::sort(queueFamilies.begin(), queueFamilies.end());
+    queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
     VkBufferCreateInfo bInfo{
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = size,
         .usage = usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .sharingMode = queueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = queueFamilies.size() > 1 ? static_cast<uint32_t>(queueFamilies.size()) : 0,
+        .pQueueFamilyIndices = queueFamilies.size() > 1 ? queueFamilies.data() : nullptr,
     };
     vkCheck(vkCreateBuffer(logDevice, &bInfo, nullptr, &buffer), "failed to create vertex buffer");
 
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(logDevice, buffer, &memRequirements);
-
-    // find memory type
-    uint32_t vbMemoryType;
-    bool vbMemoryTypeFound{false};
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memProperties);
-    for (uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
-    {
-        if ((memRequirements.memoryTypeBits & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            vbMemoryType = i;
-            vbMemoryTypeFound = true;
-        }
-    }
-    if (!vbMemoryTypeFound)
-        throw std::runtime_error("failed to find memory type for buffer");
-
-    VkMemoryAllocateInfo memInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = vbMemoryType,
-    };
-    vkCheck(vkAllocateMemory(logDevice, &memInfo, nullptr, &memory), "failed to allocate vertex buffer memory");
-
-    vkBindBufferMemory(logDevice, buffer, memory, 0);
+    memory = allocator.allocate(memRequirements, properties, true);
+    vkCheck(vkBindBufferMemory(logDevice, buffer, memory.memory, memory.offset), "failed to bind buffer memory");
 }
 
-BufferObj BufferObj::optimizeForGPU(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize size,
-                                    const void *inputData, VkBufferUsageFlagBits usageBit, CommandObj &command,
-                                    VkQueue graphicsQueue, uint32_t count)
+BufferObj::BufferObj(BufferObj &&other)
+    : buffer(other.buffer), memory(other.memory), Count(other.Count), logDevice(other.logDevice),
+      allocator(other.allocator)
 {
-    // create buffer for storing
-    BufferObj staging(logDevice, phyDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    void *data;
-    vkMapMemory(logDevice, staging.memory, 0, size, 0, &data);
-    memcpy(data, inputData, (size_t)size);
-    vkUnmapMemory(logDevice, staging.memory);
+    other.buffer = VK_NULL_HANDLE;
+    other.memory = Allocation{};
+}
 
-    BufferObj result(logDevice, phyDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usageBit,
+BufferObj BufferObj::optimizeForGPU(VkDevice logDevice, MemoryAllocator &allocator, VkDeviceSize size,
+                                    const void *inputData, VkBufferUsageFlagBits usageBit, UploadBatchObj &upload,
+                                    uint32_t count, uint64_t *ticket)
+{
+    BufferObj result(logDevice, allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usageBit,
                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, count);
-
-    // copy buffers
-    VkCommandBufferAllocateInfo tempCBInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = command.Pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-    VkCommandBuffer tempCB;
-    vkAllocateCommandBuffers(logDevice, &tempCBInfo, &tempCB);
-
-    VkCommandBufferBeginInfo beginInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
-    vkBeginCommandBuffer(tempCB, &beginInfo);
-
-    VkBufferCopy copyRegion{
-        .size = size,
-    };
-    vkCmdCopyBuffer(tempCB, staging.buffer, result.buffer, 1, &copyRegion);
-    vkEndCommandBuffer(tempCB);
-
-    VkSubmitInfo submitInfo{
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &tempCB,
-    };
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(logDevice, command.Pool, 1, &tempCB);
-
+    uint64_t uploadTicket = upload.enqueue(result.buffer, 0, inputData, size);
+    if (ticket != nullptr)
+        *ticket = uploadTicket;
     return result;
 }
 
 BufferObj::~BufferObj()
 {
     vkDestroyBuffer(logDevice, buffer, nullptr);
-    vkFreeMemory(logDevice, memory, nullptr);
+    allocator->free(memory);
 }
 
-CommandObj::CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t framesInFlight, VkClearValue clearValue)
-    : logDevice(logDevice), clearValue(clearValue)
+CommandObj::CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t framesInFlight, uint32_t images,
+                       uint32_t threadCount, VkClearValue clearValue)
+    : logDevice(logDevice), clearValue(clearValue), framesInFlight(framesInFlight),
+      threadCount(std::max(threadCount, 1u)), workers(threadCount)
 {
     // get graphics family
     uint32_t queueFamilyCount{0};
@@ -675,7 +1949,6 @@ CommandObj::CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t
     std::vector<VkQueueFamilyProperties> queueFamiliesList(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &queueFamilyCount, queueFamiliesList.data());
 
-    uint32_t graphicsFamily;
     bool foundGrFamily{false};
     for (uint32_t i{0}; i < queueFamilyCount && !foundGrFamily; ++i)
     {
@@ -695,24 +1968,184 @@ CommandObj::CommandObj(VkDevice logDevice, VkPhysicalDevice phyDevice, uint32_t
     };
     vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &Pool), "failed to create command pool");
 
-    Buffers.resize(framesInFlight);
-    VkCommandBufferAllocateInfo cbInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = Pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = framesInFlight,
+    // command pools are externally synchronized, every recording task gets its own per frame in flight
+    if (this->threadCount > 1)
+    {
+        threadPools.resize(framesInFlight * this->threadCount);
+        for (uint32_t i{0}; i < threadPools.size(); ++i)
+        {
+            vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &threadPools[i]),
+                    "failed to create command pool");
+        }
+    }
+    secondaryTask = [this](uint32_t task) { recordSecondary(task); };
+
+    resize(images);
+}
+
+void CommandObj::resize(uint32_t images)
+{
+    uint32_t count = framesInFlight * images;
+    if (count > Buffers.size())
+    {
+        uint32_t first = static_cast<uint32_t>(Buffers.size());
+        Buffers.resize(count);
+        VkCommandBufferAllocateInfo cbInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = Pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = count - first,
+        };
+        vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, &Buffers[first]), "failed to create command buffers");
+    }
+    versions.assign(Buffers.size(), 0);
+
+    // buffer frame * images + image executes secondaries allocated from the pools of its frame
+    if (threadCount > 1 && secondaries.size() != count * threadCount)
+    {
+        uint32_t oldImages = static_cast<uint32_t>(secondaries.size() / threadCount / framesInFlight);
+        std::vector<VkCommandBuffer> perPool(std::max(images, oldImages));
+        for (uint32_t frame{0}; frame < framesInFlight; ++frame)
+        {
+            for (uint32_t thread{0}; thread < threadCount; ++thread)
+            {
+                VkCommandPool threadPool = threadPools[frame * threadCount + thread];
+                for (uint32_t image{0}; image < oldImages; ++image)
+                {
+                    perPool[image] = secondaries[((frame * oldImages + image) * threadCount) + thread];
+                }
+                if (oldImages > 0)
+                    vkFreeCommandBuffers(logDevice, threadPool, oldImages, perPool.data());
+            }
+        }
+        secondaries.resize(count * threadCount);
+        for (uint32_t frame{0}; frame < framesInFlight; ++frame)
+        {
+            for (uint32_t thread{0}; thread < threadCount; ++thread)
+            {
+                VkCommandBufferAllocateInfo cbInfo{
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                    .commandPool = threadPools[frame * threadCount + thread],
+                    .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                    .commandBufferCount = images,
+                };
+                vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, perPool.data()),
+                        "failed to create secondary command buffers");
+                for (uint32_t image{0}; image < images; ++image)
+                {
+                    secondaries[((frame * images + image) * threadCount) + thread] = perPool[image];
+                }
+            }
+        }
+    }
+}
+
+void CommandObj::record(const SceneBatchObj &objects, const std::vector<MeshObj> &meshes,
+                        const std::vector<BufferObj *> &instanceBuffers, VkBuffer levelDraws,
+                        VkDescriptorSet cameraSet, VkDescriptorSet descriptorSet, uint32_t uniformStride,
+                        VkBuffer vertexBuffer, VkBuffer indexBuffer, VkRenderPass renderPass,
+                        VkFramebuffer frameBuffer, SwapChainObj &sc, uint32_t currentcb, uint32_t frame)
+{
+    drawList = {
+        .objects = &objects,
+        .meshes = &meshes,
+        .instanceBuffers = &instanceBuffers,
+        .levelDraws = levelDraws,
+        .cameraSet = cameraSet,
+        .descriptorSet = descriptorSet,
+        .uniformStride = uniformStride,
+        .vertexBuffer = vertexBuffer,
+        .indexBuffer = indexBuffer,
+        .renderPass = renderPass,
+        .frameBuffer = frameBuffer,
+        .extent = sc.extent,
+        .buffer = currentcb,
+        .frame = frame,
     };
-    vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, Buffers.data()), "failed to create command buffers");
+
+    if (threadCount == 1)
+    {
+        beginRenderPass(currentcb, frame, renderPass, frameBuffer, sc.extent, VK_SUBPASS_CONTENTS_INLINE);
+        recordDraws(Buffers[currentcb], 0, objects.size());
+    }
+    else
+    {
+        // every task records a contiguous slice of the objects into its own secondary
+        beginRenderPass(currentcb, frame, renderPass, frameBuffer, sc.extent,
+                        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        workers.run(secondaryTask, threadCount);
+        vkCmdExecuteCommands(Buffers[currentcb], threadCount, &secondaries[currentcb * threadCount]);
+    }
+    endRenderPass(currentcb);
 }
 
-void CommandObj::record(std::vector<PipelineObj *> pipelines, std::vector<VkDescriptorSet> descriptorSets,
-                        std::vector<BufferObj *> vertexBuf, std::vector<BufferObj *> indexBuf,
-                        std::vector<VkPrimitiveTopology> topologies, VkRenderPass renderPass, VkFramebuffer frameBuffer,
-                        SwapChainObj &sc, uint32_t currentcb)
+void CommandObj::recordIndirect(const IndirectFrameObj &indirect, VkDescriptorSet cameraSet, VkBuffer vertexBuffer,
+                                VkBuffer indexBuffer, VkRenderPass renderPass, VkFramebuffer frameBuffer,
+                                SwapChainObj &sc, uint32_t currentcb, uint32_t frame)
 {
-    vkCheck(vkBeginCommandBuffer(Buffers[currentcb],
-                                 new VkCommandBufferBeginInfo({.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO})),
-            "failed to record buffer");
+    VkCommandBuffer commandBuffer = Buffers[currentcb];
+    beginRenderPass(currentcb, frame, renderPass, frameBuffer, sc.extent, VK_SUBPASS_CONTENTS_INLINE);
+    setViewport(commandBuffer, sc.extent);
+
+    VkBuffer vertexBuffers[2]{vertexBuffer, indirect.instances->buffer};
+    VkDeviceSize offsets[2]{0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    // every pipeline layout is created from the same set layouts, the sets stay bound across pipelines
+    VkDescriptorSet sets[2]{cameraSet, indirect.descriptorSet};
+    if (!indirect.batches.empty())
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect.batches[0].pipeline->layout,
+                                0, 2, sets, 0, nullptr);
+
+    // culling leaves the batches where they were, only fewer or empty draws remain in them
+    VkBuffer commands =
+        indirect.culledCommands != nullptr ? indirect.culledCommands->buffer : indirect.commands->buffer;
+    VkBuffer counts = indirect.culledCounts != nullptr ? indirect.culledCounts->buffer : indirect.counts->buffer;
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    for (uint32_t i{0}; i < indirect.batches.size(); ++i)
+    {
+        const IndirectBatch &batch = indirect.batches[i];
+        VkDeviceSize offset = VkDeviceSize(stride) * batch.firstCommand;
+        uint32_t interval{GpuProfiler::NONE};
+        if (profiler != nullptr)
+            interval = profiler->begin(commandBuffer, currentcb, batch.pipeline->profilerScope);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline->pl);
+        // the first index of every mesh counts in indices of its own type from the start of the buffer
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, batch.indexType);
+        if (drawIndexedIndirectCount != nullptr && multiDrawIndirect)
+        {
+            // the GPU reads the count, whatever writes the commands may draw fewer than the batch holds
+            drawIndexedIndirectCount(commandBuffer, commands, offset, counts, sizeof(uint32_t) * i, batch.commandCount,
+                                     stride);
+        }
+        else if (multiDrawIndirect)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, commands, offset, batch.commandCount, stride);
+        }
+        else
+        {
+            for (uint32_t j{0}; j < batch.commandCount; ++j)
+            {
+                vkCmdDrawIndexedIndirect(commandBuffer, commands, offset + stride * j, 1, stride);
+            }
+        }
+        if (profiler != nullptr)
+            profiler->end(commandBuffer, currentcb, interval);
+    }
+    endRenderPass(currentcb);
+}
+
+void CommandObj::beginRenderPass(uint32_t currentcb, uint32_t frame, VkRenderPass renderPass,
+                                 VkFramebuffer frameBuffer, VkExtent2D extent, VkSubpassContents contents)
+{
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    vkCheck(vkBeginCommandBuffer(Buffers[currentcb], &beginInfo), "failed to record buffer");
+    if (profiler != nullptr)
+    {
+        profiler->beginBuffer(Buffers[currentcb], currentcb, frame);
+        renderPassInterval = profiler->begin(Buffers[currentcb], currentcb, renderPassScope);
+    }
 
     VkClearValue clearValues[2];
     clearValues[0] = clearValue;
@@ -724,68 +2157,178 @@ void CommandObj::record(std::vector<PipelineObj *> pipelines, std::vector<VkDesc
         .renderArea =
             {
                 .offset = {0, 0},
-                .extent = sc.extent,
+                .extent = extent,
             },
         .clearValueCount = 2,
         .pClearValues = clearValues,
     };
+    vkCmdBeginRenderPass(Buffers[currentcb], &renderPassInfo, contents);
+}
+
+void CommandObj::endRenderPass(uint32_t currentcb)
+{
+    vkCmdEndRenderPass(Buffers[currentcb]);
+    if (profiler != nullptr)
+        profiler->end(Buffers[currentcb], currentcb, renderPassInterval);
+    vkCheck(vkEndCommandBuffer(Buffers[currentcb]), "failed to record buffer");
+}
+
+void CommandObj::setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
     VkViewport viewport{
         .x = 0.0f,
         .y = 0.0f,
-        .width = static_cast<float>(sc.extent.width),
-        .height = static_cast<float>(sc.extent.height),
+        .width = static_cast<float>(extent.width),
+        .height = static_cast<float>(extent.height),
         .minDepth = 0.0f,
         .maxDepth = 1.0,
     };
     VkRect2D scissor{
         .offset = {0, 0},
-        .extent = sc.extent,
+        .extent = extent,
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void CommandObj::recordSecondary(uint32_t task)
+{
+    CpuScope scope(cpuProfiler, "record secondary");
+    VkCommandBuffer secondary = secondaries[drawList.buffer * threadCount + task];
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = drawList.renderPass,
+        .subpass = 0,
+        .framebuffer = drawList.frameBuffer,
+    };
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo,
     };
-    vkCmdBeginRenderPass(Buffers[currentcb], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkResetCommandBuffer(secondary, 0);
+    vkCheck(vkBeginCommandBuffer(secondary, &beginInfo), "failed to record secondary buffer");
+    uint32_t objectCount = drawList.objects->size();
+    recordDraws(secondary, static_cast<uint32_t>(uint64_t(objectCount) * task / threadCount),
+                static_cast<uint32_t>(uint64_t(objectCount) * (task + 1) / threadCount));
+    vkCheck(vkEndCommandBuffer(secondary), "failed to record secondary buffer");
+}
 
-    for (uint32_t i{0}; i < vertexBuf.size(); ++i)
+void CommandObj::recordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last)
+{
+    setViewport(commandBuffer, drawList.extent);
+    // every mesh lives in the shared buffers, only the instances change between objects
+    VkDeviceSize offset{0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawList.vertexBuffer, &offset);
+    // the first index of every mesh counts in indices of its own type from the start of the buffer
+    VkIndexType indexType{VK_INDEX_TYPE_MAX_ENUM};
+
+    const SceneBatchObj &objects = *drawList.objects;
+    const std::vector<MeshObj> &meshes = *drawList.meshes;
+    // a group of draws ends where the pipeline changes, secondaries are only timed as part of the render pass
+    bool timed = profiler != nullptr && commandBuffer == Buffers[drawList.buffer];
+    const PipelineObj *groupPipeline{nullptr};
+    uint32_t interval{GpuProfiler::NONE};
+    for (uint32_t i{first}; i < last; ++i)
     {
-        PipelineObj *pipeline;
-        for (uint8_t j{0}; j < pipelines.size(); ++j)
+        const PipelineObj *pipeline = objects.pipelines[i];
+        const MeshObj &mesh = meshes[objects.meshes[i]];
+        uint32_t instanceCount = objects.instanceCounts[i];
+        if (pipeline == nullptr || instanceCount == 0)
+            continue;
+        if (timed && pipeline != groupPipeline)
         {
-            if (topologies[i] == pipelines[j]->topology)
-                pipeline = pipelines[j];
+            profiler->end(commandBuffer, drawList.buffer, interval);
+            groupPipeline = pipeline;
+            interval = profiler->begin(commandBuffer, drawList.buffer, groupPipeline->profilerScope);
         }
-        vkCmdBindPipeline(Buffers[currentcb], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pl);
-        vkCmdSetViewport(Buffers[currentcb], 0, 1, &viewport);
-        vkCmdSetScissor(Buffers[currentcb], 0, 1, &scissor);
-        vkCmdBindVertexBuffers(Buffers[currentcb], 0, 1, &vertexBuf[i]->buffer, new VkDeviceSize(0));
-        vkCmdBindDescriptorSets(Buffers[currentcb], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, 1,
-                                &descriptorSets[i], 0, nullptr);
-        if (indexBuf[i] != nullptr)
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pl);
+        if (mesh.indexType != indexType)
         {
-            vkCmdBindIndexBuffer(Buffers[currentcb], indexBuf[i]->buffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(Buffers[currentcb], indexBuf[i]->Count, 1, 0, 0, 0);
+            indexType = mesh.indexType;
+            vkCmdBindIndexBuffer(commandBuffer, drawList.indexBuffer, 0, indexType);
         }
-        else
+        VkDescriptorSet sets[2]{drawList.cameraSet, drawList.descriptorSet};
+        uint32_t uniformOffset = drawList.uniformStride * i;
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, 2, sets, 1,
+                                &uniformOffset);
+        // every level of detail reads its instances from a region of its own and its instance count from the draws
+        // draw writes every frame, switching levels leaves the recorded commands as they are
+        uint32_t levels = objectLevels(objects, i, mesh);
+        for (uint32_t j{0}; j < levels; ++j)
         {
-            vkCmdDraw(Buffers[currentcb], vertexBuf[i]->Count, 1, 0, 0);
+            VkDeviceSize instanceOffset = sizeof(InstanceData) * VkDeviceSize(instanceCount) * j;
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1,
+                                   &(*drawList.instanceBuffers)[drawList.frame + framesInFlight * i]->buffer,
+                                   &instanceOffset);
+            vkCmdDrawIndexedIndirect(commandBuffer, drawList.levelDraws,
+                                     sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize(maxLods) * i + j), 1,
+                                     sizeof(VkDrawIndexedIndirectCommand));
         }
     }
-    vkCmdEndRenderPass(Buffers[currentcb]);
-    vkCheck(vkEndCommandBuffer(Buffers[currentcb]), "failed to record buffer");
+    if (timed)
+        profiler->end(commandBuffer, drawList.buffer, interval);
 }
 
 CommandObj::~CommandObj()
 {
+    for (uint32_t i{0}; i < threadPools.size(); ++i)
+    {
+        vkDestroyCommandPool(logDevice, threadPools[i], nullptr);
+    }
     vkDestroyCommandPool(logDevice, Pool, nullptr);
 }
 
 SwapChainObj::SwapChainObj(VkDevice logDevice, VkPhysicalDevice phyDevice, VkSurfaceKHR surface,
-                           std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize)
+                           std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize,
+                           MemoryAllocator &allocator, VkFormat offscreenFormat, uint32_t offscreenCount,
+                           VkSwapchainKHR oldSwapChain)
     : logDevice(logDevice)
 {
-    initSwapChain(phyDevice, surface, getFrameBufferSize);
+    if (surface == VK_NULL_HANDLE)
+    {
+        initOffscreen(getFrameBufferSize, allocator, offscreenFormat, offscreenCount);
+        return;
+    }
+    initSwapChain(phyDevice, surface, getFrameBufferSize, oldSwapChain);
     initImageViews();
 }
 
+SwapChainObj::SwapChainObj(SwapChainObj &&other)
+    : SwapChain(other.SwapChain), format(other.format), extent(other.extent), images(std::move(other.images)),
+      imageViews(std::move(other.imageViews)), offscreenImages(std::move(other.offscreenImages)),
+      copySource(other.copySource), logDevice(other.logDevice)
+{
+    other.SwapChain = VK_NULL_HANDLE;
+    other.images.clear();
+    other.imageViews.clear();
+    other.offscreenImages.clear();
+}
+
+SwapChainObj &SwapChainObj::operator=(SwapChainObj &&other)
+{
+    if (this != &other)
+    {
+        destroy();
+        SwapChain = other.SwapChain;
+        format = other.format;
+        extent = other.extent;
+        images = std::move(other.images);
+        imageViews = std::move(other.imageViews);
+        offscreenImages = std::move(other.offscreenImages);
+        copySource = other.copySource;
+        logDevice = other.logDevice;
+        other.SwapChain = VK_NULL_HANDLE;
+        other.images.clear();
+        other.imageViews.clear();
+        other.offscreenImages.clear();
+    }
+    return *this;
+}
+
 void SwapChainObj::initSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surface,
-                                 std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize)
+                                 std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize,
+                                 VkSwapchainKHR oldSwapChain)
 {
     VkSurfaceCapabilitiesKHR capabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(phyDevice, surface, &capabilities);
@@ -880,7 +2423,9 @@ void SwapChainObj::initSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surfac
         .imageColorSpace = colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // frames can only be read back from images that allow copies out of them
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                      (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
         .imageSharingMode = queueFamilies.size() > 2 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = queueFamilies.size() > 2 ? static_cast<uint32_t>(queueFamilies.size()) : 0,
         .pQueueFamilyIndices = queueFamilies.size() > 2 ? _queueFamilies.data() : nullptr,
@@ -888,9 +2433,10 @@ void SwapChainObj::initSwapChain(VkPhysicalDevice phyDevice, VkSurfaceKHR surfac
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = presentMode,
         .clipped = VK_TRUE,
-        .oldSwapchain = VK_NULL_HANDLE,
+        .oldSwapchain = oldSwapChain,
     };
     vkCheck(vkCreateSwapchainKHR(logDevice, &schInfo, nullptr, &SwapChain), "failed to create swap chain");
+    copySource = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
 
     vkGetSwapchainImagesKHR(logDevice, SwapChain, &imageCount, nullptr);
     images.resize(imageCount);
@@ -928,13 +2474,42 @@ void SwapChainObj::initImageViews()
     }
 }
 
+void SwapChainObj::initOffscreen(std::function<void(uint32_t &width, uint32_t &height)> getFrameBufferSize,
+                                 MemoryAllocator &allocator, VkFormat offscreenFormat, uint32_t offscreenCount)
+{
+    format = offscreenFormat;
+    getFrameBufferSize(extent.width, extent.height);
+    for (uint32_t i{0}; i < offscreenCount; ++i)
+    {
+        offscreenImages.push_back(new ImageObj(logDevice, allocator, extent, VK_SAMPLE_COUNT_1_BIT, format,
+                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                               VK_IMAGE_ASPECT_COLOR_BIT));
+        images.push_back(offscreenImages[i]->image);
+        imageViews.push_back(offscreenImages[i]->view);
+    }
+}
+
 SwapChainObj::~SwapChainObj()
 {
+    destroy();
+}
+
+void SwapChainObj::destroy()
+{
+    // headless image views belong to the offscreen images, a moved from object owns nothing
+    for (uint32_t i{0}; i < offscreenImages.size(); ++i)
+    {
+        delete offscreenImages[i];
+    }
+    offscreenImages.clear();
+    if (SwapChain == VK_NULL_HANDLE)
+        return;
     for (uint16_t i{0}; i < imageViews.size(); ++i)
     {
         vkDestroyImageView(logDevice, imageViews[i], nullptr);
     }
     vkDestroySwapchainKHR(logDevice, SwapChain, nullptr);
+    SwapChain = VK_NULL_HANDLE;
 }
 
 ShaderObj::ShaderObj(VkDevice logDevice, std::string shaderLocation, VkShaderStageFlagBits shaderStageBit)
@@ -0,0 +1,382 @@
+#include "../headers/memory.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+static uint32_t mostSignificantBit(VkDeviceSize value)
+{
+    return 63 - __builtin_clzll(value);
+}
+
+static void mapping(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+{
+    uint32_t msb = mostSignificantBit(size);
+    if (msb < MemoryBlock::SL_BITS)
+    {
+        // small sizes are stored linearly in the first list
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+    }
+    else
+    {
+        fl = msb - MemoryBlock::SL_BITS + 1;
+        sl = static_cast<uint32_t>(size >> (msb - MemoryBlock::SL_BITS)) ^ MemoryBlock::SL_COUNT;
+    }
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void *mapped, uint32_t memoryType)
+    : memory(memory), size(size), mapped(mapped), memoryType(memoryType)
+{
+    for (uint32_t i{0}; i < FL_COUNT; ++i)
+    {
+        for (uint32_t j{0}; j < SL_COUNT; ++j)
+        {
+            freeHeads[i][j] = NONE;
+        }
+    }
+    insertFree(newChunk(0, size));
+}
+
+uint32_t MemoryBlock::newChunk(VkDeviceSize offset, VkDeviceSize chunkSize)
+{
+    Chunk chunk{
+        .offset = offset,
+        .size = chunkSize,
+    };
+    if (!unusedChunks.empty())
+    {
+        uint32_t index = unusedChunks.back();
+        unusedChunks.pop_back();
+        chunks[index] = chunk;
+        return index;
+    }
+    chunks.push_back(chunk);
+    return static_cast<uint32_t>(chunks.size() - 1);
+}
+
+void MemoryBlock::insertFree(uint32_t chunk)
+{
+    uint32_t fl, sl;
+    mapping(chunks[chunk].size, fl, sl);
+    chunks[chunk].free = true;
+    chunks[chunk].prevFree = NONE;
+    chunks[chunk].nextFree = freeHeads[fl][sl];
+    if (freeHeads[fl][sl] != NONE)
+        chunks[freeHeads[fl][sl]].prevFree = chunk;
+    freeHeads[fl][sl] = chunk;
+    slBitmap[fl] |= 1u << sl;
+    flBitmap |= 1ull << fl;
+}
+
+void MemoryBlock::removeFree(uint32_t chunk)
+{
+    uint32_t fl, sl;
+    mapping(chunks[chunk].size, fl, sl);
+    uint32_t prev = chunks[chunk].prevFree;
+    uint32_t next = chunks[chunk].nextFree;
+    if (prev != NONE)
+        chunks[prev].nextFree = next;
+    if (next != NONE)
+        chunks[next].prevFree = prev;
+    if (freeHeads[fl][sl] == chunk)
+    {
+        freeHeads[fl][sl] = next;
+        if (next == NONE)
+        {
+            slBitmap[fl] &= ~(1u << sl);
+            if (slBitmap[fl] == 0)
+                flBitmap &= ~(1ull << fl);
+        }
+    }
+    chunks[chunk].free = false;
+}
+
+uint32_t MemoryBlock::findFree(VkDeviceSize minSize)
+{
+    // round up to the next list so that every chunk in the found list is big enough
+    uint32_t msb = mostSignificantBit(minSize);
+    if (msb >= SL_BITS)
+        minSize += (1ull << (msb - SL_BITS)) - 1;
+
+    uint32_t fl, sl;
+    mapping(minSize, fl, sl);
+    if (fl >= FL_COUNT)
+        return NONE;
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0)
+            return NONE;
+        fl = __builtin_ctzll(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = __builtin_ctz(slMap);
+    return freeHeads[fl][sl];
+}
+
+void MemoryBlock::split(uint32_t chunk, VkDeviceSize firstSize)
+{
+    uint32_t second = newChunk(chunks[chunk].offset + firstSize, chunks[chunk].size - firstSize);
+    chunks[second].prevPhys = chunk;
+    chunks[second].nextPhys = chunks[chunk].nextPhys;
+    if (chunks[chunk].nextPhys != NONE)
+        chunks[chunks[chunk].nextPhys].prevPhys = second;
+    chunks[chunk].nextPhys = second;
+    chunks[chunk].size = firstSize;
+}
+
+bool MemoryBlock::allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &chunk)
+{
+    if (allocSize == 0)
+        allocSize = 1;
+    uint32_t found = findFree(allocSize + (alignment > 1 ? alignment - 1 : 0));
+    if (found == NONE)
+        return false;
+    removeFree(found);
+
+    VkDeviceSize padding = alignUp(chunks[found].offset, alignment) - chunks[found].offset;
+    if (padding > 0)
+    {
+        // the physical neighbours of a free chunk are never free, the padding can go straight back
+        split(found, padding);
+        uint32_t aligned = chunks[found].nextPhys;
+        insertFree(found);
+        found = aligned;
+    }
+    if (chunks[found].size > allocSize)
+    {
+        split(found, allocSize);
+        insertFree(chunks[found].nextPhys);
+    }
+
+    offset = chunks[found].offset;
+    chunk = found;
+    allocationCount++;
+    usedBytes += chunks[found].size;
+    return true;
+}
+
+void MemoryBlock::free(uint32_t chunk)
+{
+    allocationCount--;
+    usedBytes -= chunks[chunk].size;
+
+    uint32_t prev = chunks[chunk].prevPhys;
+    if (prev != NONE && chunks[prev].free)
+    {
+        removeFree(prev);
+        chunks[prev].size += chunks[chunk].size;
+        chunks[prev].nextPhys = chunks[chunk].nextPhys;
+        if (chunks[chunk].nextPhys != NONE)
+            chunks[chunks[chunk].nextPhys].prevPhys = prev;
+        unusedChunks.push_back(chunk);
+        chunk = prev;
+    }
+    uint32_t next = chunks[chunk].nextPhys;
+    if (next != NONE && chunks[next].free)
+    {
+        removeFree(next);
+        chunks[chunk].size += chunks[next].size;
+        chunks[chunk].nextPhys = chunks[next].nextPhys;
+        if (chunks[next].nextPhys != NONE)
+            chunks[chunks[next].nextPhys].prevPhys = chunk;
+        unusedChunks.push_back(next);
+    }
+    insertFree(chunk);
+}
+
+MemoryAllocator::MemoryAllocator(VkDevice logDevice, VkPhysicalDevice phyDevice, VkDeviceSize preferredBlockSize)
+    : logDevice(logDevice)
+{
+    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memProperties);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(phyDevice, &deviceProperties);
+    bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+    maxDeviceMemoryCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+    blockSizes.resize(memProperties.memoryHeapCount);
+    for (uint32_t i{0}; i < memProperties.memoryHeapCount; ++i)
+    {
+        // small heaps (e.g. the 256MiB BAR heap) would be exhausted by a handful of full sized blocks
+        VkDeviceSize heapSize = memProperties.memoryHeaps[i].size;
+        blockSizes[i] = heapSize <= (1ull << 30) ? std::min(preferredBlockSize, heapSize / 8) : preferredBlockSize;
+    }
+    pools.resize(memProperties.memoryTypeCount * 2);
+    dedicated.resize(memProperties.memoryHeapCount);
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+    for (uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
+    {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+    throw std::runtime_error("failed to find memory type");
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped)
+{
+    VkMemoryAllocateInfo memInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType,
+    };
+    VkDeviceMemory memory;
+    vkCheck(vkAllocateMemory(logDevice, &memInfo, nullptr, &memory), "failed to allocate device memory");
+    deviceMemoryCount++;
+
+    *mapped = nullptr;
+    // host visible blocks stay mapped for their whole lifetime, a VkDeviceMemory can only be mapped once
+    if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vkCheck(vkMapMemory(logDevice, memory, 0, VK_WHOLE_SIZE, 0, mapped), "failed to map device memory");
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType)
+{
+    vkFreeMemory(logDevice, memory, nullptr);
+    deviceMemoryCount--;
+}
+
+Allocation MemoryAllocator::allocate(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Allocation allocation;
+    allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    allocation.size = requirements.size;
+    uint32_t heap = memProperties.memoryTypes[allocation.memoryType].heapIndex;
+
+    if (requirements.size > blockSizes[heap] / 2)
+    {
+        // big resources get their own VkDeviceMemory instead of wasting most of a block
+        allocation.memory = allocateDeviceMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+        dedicated[heap].dedicatedCount++;
+        dedicated[heap].allocationCount++;
+        dedicated[heap].reservedBytes += requirements.size;
+        dedicated[heap].usedBytes += requirements.size;
+        return allocation;
+    }
+
+    uint32_t poolIndex = allocation.memoryType * 2 + (bufferImageGranularity > 1 && linear ? 1 : 0);
+    std::vector<MemoryBlock *> &pool = pools[poolIndex];
+    MemoryBlock *block{nullptr};
+    for (uint32_t i{0}; i < pool.size() && block == nullptr; ++i)
+    {
+        if (pool[i]->allocate(requirements.size, requirements.alignment, allocation.offset, allocation.chunk))
+            block = pool[i];
+    }
+    if (block == nullptr)
+    {
+        void *mapped;
+        VkDeviceMemory memory = allocateDeviceMemory(blockSizes[heap], allocation.memoryType, &mapped);
+        pool.push_back(new MemoryBlock(memory, blockSizes[heap], mapped, allocation.memoryType));
+        block = pool.back();
+        if (!block->allocate(requirements.size, requirements.alignment, allocation.offset, allocation.chunk))
+            throw std::runtime_error("failed to sub-allocate device memory");
+    }
+
+    allocation.memory = block->memory;
+    allocation.block = block;
+    if (block->mapped != nullptr)
+        allocation.mapped = static_cast<char *>(block->mapped) + allocation.offset;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t heap = memProperties.memoryTypes[allocation.memoryType].heapIndex;
+
+    if (allocation.block == nullptr)
+    {
+        freeDeviceMemory(allocation.memory, allocation.memoryType);
+        dedicated[heap].dedicatedCount--;
+        dedicated[heap].allocationCount--;
+        dedicated[heap].reservedBytes -= allocation.size;
+        dedicated[heap].usedBytes -= allocation.size;
+        allocation = Allocation{};
+        return;
+    }
+
+    MemoryBlock *block = allocation.block;
+    block->free(allocation.chunk);
+    if (block->allocationCount == 0)
+    {
+        // keep a single empty block per pool so alloc/free churn doesn't hit vkAllocateMemory every time
+        for (uint32_t p{allocation.memoryType * 2}; p < allocation.memoryType * 2 + 2; ++p)
+        {
+            std::vector<MemoryBlock *> &pool = pools[p];
+            std::vector<MemoryBlock *>::iterator it = std::find(pool.begin(), pool.end(), block);
+            if (it == pool.end())
+                continue;
+            uint32_t emptyBlocks{0};
+            for (uint32_t i{0}; i < pool.size(); ++i)
+            {
+                if (pool[i]->allocationCount == 0)
+                    emptyBlocks++;
+            }
+            if (emptyBlocks > 1)
+            {
+                freeDeviceMemory(block->memory, block->memoryType);
+                delete block;
+                pool.erase(it);
+            }
+            break;
+        }
+    }
+    allocation = Allocation{};
+}
+
+MemoryStats MemoryAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats{
+        .deviceMemoryCount = deviceMemoryCount,
+        .maxDeviceMemoryCount = maxDeviceMemoryCount,
+        .heaps = dedicated,
+    };
+    for (uint32_t i{0}; i < pools.size(); ++i)
+    {
+        for (uint32_t j{0}; j < pools[i].size(); ++j)
+        {
+            MemoryHeapStats &heap = stats.heaps[memProperties.memoryTypes[pools[i][j]->memoryType].heapIndex];
+            heap.blockCount++;
+            heap.allocationCount += pools[i][j]->allocationCount;
+            heap.reservedBytes += pools[i][j]->size;
+            heap.usedBytes += pools[i][j]->usedBytes;
+        }
+    }
+    for (uint32_t i{0}; i < stats.heaps.size(); ++i)
+    {
+        stats.total.blockCount += stats.heaps[i].blockCount;
+        stats.total.dedicatedCount += stats.heaps[i].dedicatedCount;
+        stats.total.allocationCount += stats.heaps[i].allocationCount;
+        stats.total.reservedBytes += stats.heaps[i].reservedBytes;
+        stats.total.usedBytes += stats.heaps[i].usedBytes;
+    }
+    return stats;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    for (uint32_t i{0}; i < pools.size(); ++i)
+    {
+        for (uint32_t j{0}; j < pools[i].size(); ++j)
+        {
+            freeDeviceMemory(pools[i][j]->memory, pools[i][j]->memoryType);
+            delete pools[i][j];
+        }
+    }
+}
+
+} // namespace Cthovk
@@ -0,0 +1,30 @@
+#include "../headers/meshadjacency.h"
+
+namespace Cthovk
+{
+
+void TriangleAdjacencyObj::build(const uint32_t *indices, uint32_t indexCount, uint32_t vertexCount)
+{
+    offsets.assign(vertexCount + 1, 0);
+    for (uint32_t i{0}; i < indexCount; ++i)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    triangles.resize(indexCount);
+    for (uint32_t i{0}; i < indexCount; ++i)
+    {
+        triangles[offsets[indices[i]]++] = i / 3;
+    }
+    // filling moved every offset to the start of the next vertex
+    for (uint32_t i{vertexCount}; i > 0; --i)
+    {
+        offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
+}
+
+} // namespace Cthovk
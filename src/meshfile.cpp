@@ -0,0 +1,121 @@
+#include "../headers/meshfile.h"
+
+namespace Cthovk
+{
+
+static uint64_t alignUp(uint64_t offset)
+{
+    return (offset + MeshFileHeader::ALIGNMENT - 1) / MeshFileHeader::ALIGNMENT * MeshFileHeader::ALIGNMENT;
+}
+
+MeshBounds computeBounds(const Vertex *vertices, uint32_t vertexCount)
+{
+    glm::vec3 low{vertexCount == 0 ? glm::vec3(0.0f) : vertices[0].pos};
+    glm::vec3 high{low};
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        low = glm::min(low, vertices[i].pos);
+        high = glm::max(high, vertices[i].pos);
+    }
+    float radius{0.0f};
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        radius = std::max(radius, glm::length(vertices[i].pos - (low + high) * 0.5f));
+    }
+    return {
+        .min = low,
+        .max = high,
+        .sphere = glm::vec4((low + high) * 0.5f, radius),
+    };
+}
+
+void writeMeshFile(const std::string &location, const Vertex *vertices, uint32_t vertexCount,
+                   const uint32_t *indices, uint32_t indexCount, uint32_t flags)
+{
+    std::vector<uint32_t> sequentialIndices;
+    if (indexCount == 0)
+    {
+        sequentialIndices.resize(vertexCount);
+        std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0);
+        indices = sequentialIndices.data();
+        indexCount = vertexCount;
+    }
+
+    MeshBounds bounds = computeBounds(vertices, vertexCount);
+    MeshFileHeader header{
+        .magic = MeshFileHeader::MAGIC,
+        .version = MeshFileHeader::VERSION,
+        .vertexStride = sizeof(Vertex),
+        .vertexCount = vertexCount,
+        .indexCount = indexCount,
+        .flags = flags,
+        .vertexOffset = alignUp(sizeof(MeshFileHeader)),
+        .indexOffset = alignUp(alignUp(sizeof(MeshFileHeader)) + sizeof(Vertex) * uint64_t(vertexCount)),
+        .boundsMin = bounds.min,
+        .boundsMax = bounds.max,
+        .sphere = bounds.sphere,
+    };
+
+    std::ofstream file(location, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open mesh file: " + location);
+    const char padding[MeshFileHeader::ALIGNMENT]{};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(padding, header.vertexOffset - sizeof(header));
+    file.write(reinterpret_cast<const char *>(vertices), sizeof(Vertex) * uint64_t(vertexCount));
+    file.write(padding, header.indexOffset - header.vertexOffset - sizeof(Vertex) * uint64_t(vertexCount));
+    file.write(reinterpret_cast<const char *>(indices), sizeof(uint32_t) * uint64_t(indexCount));
+    if (!file.good())
+        throw std::runtime_error("failed to write mesh file: " + location);
+}
+
+MeshFileObj::MeshFileObj(const std::string &location)
+{
+    int descriptor = open(location.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw std::runtime_error("failed to open mesh file: " + location);
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(MeshFileHeader)))
+    {
+        size = static_cast<size_t>(status.st_size);
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    // the mapping keeps the file referenced
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("failed to map mesh file: " + location);
+    // the blobs are read front to back exactly once
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    madvise(mapping, size, MADV_WILLNEED);
+
+    memcpy(&header, mapping, sizeof(header));
+    uint64_t vertexBytes = sizeof(Vertex) * uint64_t(header.vertexCount);
+    uint64_t indexBytes = sizeof(uint32_t) * uint64_t(header.indexCount);
+    if (header.magic != MeshFileHeader::MAGIC || header.version != MeshFileHeader::VERSION ||
+        header.vertexStride != sizeof(Vertex) || header.vertexOffset % MeshFileHeader::ALIGNMENT != 0 ||
+        header.indexOffset % MeshFileHeader::ALIGNMENT != 0 || header.vertexOffset > size ||
+        vertexBytes > size - header.vertexOffset || header.indexOffset > size ||
+        indexBytes > size - header.indexOffset)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("invalid mesh file: " + location);
+    }
+    vertices = reinterpret_cast<const Vertex *>(static_cast<const char *>(mapping) + header.vertexOffset);
+    indices = reinterpret_cast<const uint32_t *>(static_cast<const char *>(mapping) + header.indexOffset);
+    // the GPU would read past the vertices of the mesh, the pages stay cached for the upload
+    for (uint32_t i{0}; i < header.indexCount; ++i)
+    {
+        if (indices[i] >= header.vertexCount)
+        {
+            munmap(mapping, size);
+            throw std::runtime_error("mesh file indexes past its vertices: " + location);
+        }
+    }
+}
+
+MeshFileObj::~MeshFileObj()
+{
+    munmap(mapping, size);
+}
+
+} // namespace Cthovk
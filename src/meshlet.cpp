@@ -0,0 +1,158 @@
+#include "../headers/meshlet.h"
+
+namespace Cthovk
+{
+
+// bounding sphere and normal cone of the triangleCount triangles starting at indices
+static void computeMeshletBounds(const Vertex *vertices, const uint32_t *indices, uint32_t triangleCount,
+                                 Meshlet &meshlet)
+{
+    glm::vec3 low{std::numeric_limits<float>::max()};
+    glm::vec3 high{std::numeric_limits<float>::lowest()};
+    for (uint32_t i{0}; i < 3 * triangleCount; ++i)
+    {
+        low = glm::min(low, vertices[indices[i]].pos);
+        high = glm::max(high, vertices[indices[i]].pos);
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius{0.0f};
+    for (uint32_t i{0}; i < 3 * triangleCount; ++i)
+    {
+        radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // degenerate triangles cover no pixels and leave the cone as it is
+    auto normal = [&](uint32_t triangle) {
+        const glm::vec3 &a = vertices[indices[3 * triangle]].pos;
+        const glm::vec3 &b = vertices[indices[3 * triangle + 1]].pos;
+        const glm::vec3 &c = vertices[indices[3 * triangle + 2]].pos;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        return length > 0.0f ? n / length : glm::vec3(0.0f);
+    };
+    glm::vec3 axis(0.0f);
+    for (uint32_t i{0}; i < triangleCount; ++i)
+    {
+        axis += normal(i);
+    }
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float length = glm::length(axis);
+    if (length == 0.0f)
+        return;
+    axis /= length;
+    float minDot{1.0f};
+    for (uint32_t i{0}; i < triangleCount; ++i)
+    {
+        glm::vec3 n = normal(i);
+        if (n != glm::vec3(0.0f))
+            minDot = std::min(minDot, glm::dot(n, axis));
+    }
+    // normals more than 90 degrees from the axis, some triangle faces every point of view
+    if (minDot <= 0.0f)
+        return;
+    meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
+
+std::vector<Meshlet> buildMeshlets(const Vertex *vertices, uint32_t vertexCount, std::vector<uint32_t> &indices,
+                                   uint32_t maxVertices, uint32_t maxTriangles)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<Meshlet> meshlets;
+    if (triangleCount == 0)
+        return meshlets;
+
+    TriangleAdjacencyObj adjacency;
+    adjacency.build(indices.data(), 3 * triangleCount, vertexCount);
+    std::vector<uint32_t> liveTriangles(vertexCount); // not emitted yet
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        liveTriangles[i] = adjacency.count(i);
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(3 * triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> owners(vertexCount, UINT32_MAX); // meshlet every vertex was last added to
+    std::vector<uint32_t> candidates; // triangles around the meshlet, emitted ones are dropped on the next pass
+    uint32_t cursor{0};
+    while (result.size() < 3 * triangleCount)
+    {
+        uint32_t owner = static_cast<uint32_t>(meshlets.size());
+        uint32_t meshletVertices{0};
+        uint32_t meshletTriangles{0};
+        Meshlet meshlet{
+            .firstIndex = static_cast<uint32_t>(result.size()),
+        };
+        glm::vec3 positionSum(0.0f);
+        candidates.clear();
+        while (emitted[cursor])
+        {
+            cursor++;
+        }
+        int64_t next{cursor};
+        while (next >= 0)
+        {
+            for (uint32_t j{0}; j < 3; ++j)
+            {
+                uint32_t vertex = indices[3 * next + j];
+                result.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (owners[vertex] == owner)
+                    continue;
+                owners[vertex] = owner;
+                meshletVertices++;
+                positionSum += vertices[vertex].pos;
+                candidates.insert(candidates.end(), adjacency.triangles.begin() + adjacency.offsets[vertex],
+                                  adjacency.triangles.begin() + adjacency.offsets[vertex + 1]);
+            }
+            emitted[next] = true;
+            if (++meshletTriangles == maxTriangles)
+                break;
+
+            // the triangle adding the fewest vertices, ties go to the one whose vertices have the fewest triangles
+            // left so the meshlet does not leave islands behind and then to the one closest to the meshlet
+            next = -1;
+            uint32_t bestAdded{4};
+            uint32_t bestLive{UINT32_MAX};
+            float bestDistance{0.0f};
+            glm::vec3 centroid = positionSum / static_cast<float>(meshletVertices);
+            uint32_t kept{0};
+            for (uint32_t i{0}; i < candidates.size(); ++i)
+            {
+                uint32_t triangle = candidates[i];
+                if (emitted[triangle])
+                    continue;
+                candidates[kept++] = triangle;
+                uint32_t added{0};
+                uint32_t live{0};
+                for (uint32_t j{0}; j < 3; ++j)
+                {
+                    added += owners[indices[3 * triangle + j]] != owner;
+                    live += liveTriangles[indices[3 * triangle + j]];
+                }
+                if (meshletVertices + added > maxVertices || added > bestAdded ||
+                    (added == bestAdded && live > bestLive))
+                    continue;
+                glm::vec3 offset = (vertices[indices[3 * triangle]].pos + vertices[indices[3 * triangle + 1]].pos +
+                                    vertices[indices[3 * triangle + 2]].pos) / 3.0f - centroid;
+                float distance = glm::dot(offset, offset);
+                if (added < bestAdded || live < bestLive || distance < bestDistance)
+                {
+                    bestAdded = added;
+                    bestLive = live;
+                    bestDistance = distance;
+                    next = triangle;
+                }
+            }
+            candidates.resize(kept);
+        }
+        meshlet.indexCount = 3 * meshletTriangles;
+        computeMeshletBounds(vertices, result.data() + meshlet.firstIndex, meshletTriangles, meshlet);
+        meshlets.push_back(meshlet);
+    }
+    indices = std::move(result);
+    return meshlets;
+}
+
+} // namespace Cthovk
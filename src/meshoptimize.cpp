@@ -0,0 +1,273 @@
+#include "../headers/meshoptimize.h"
+
+namespace Cthovk
+{
+
+// fifo cache of the last cacheSize transformed vertices, a vertex is cached while fewer than cacheSize misses
+// happened since it was transformed
+struct VertexCacheObj
+{
+    uint32_t cacheSize;
+    std::vector<uint32_t> stamps;
+    uint32_t time;
+
+    VertexCacheObj(uint32_t vertexCount, uint32_t cacheSize)
+        : cacheSize(cacheSize), stamps(vertexCount, 0), time(cacheSize + 1)
+    {
+    }
+
+    // true when the vertex had to be transformed
+    bool use(uint32_t vertex)
+    {
+        if (time - stamps[vertex] <= cacheSize)
+            return false;
+        stamps[vertex] = time++;
+        return true;
+    }
+
+    uint32_t useTriangle(const uint32_t *triangle)
+    {
+        return use(triangle[0]) + use(triangle[1]) + use(triangle[2]);
+    }
+
+    void flush()
+    {
+        time += cacheSize + 1;
+    }
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheObj cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t misses{0};
+    uint32_t referencedCount{0};
+    for (uint32_t i{0}; i < indices.size(); ++i)
+    {
+        misses += cache.use(indices[i]);
+        referencedCount += !referenced[indices[i]];
+        referenced[indices[i]] = true;
+    }
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    return {
+        .acmr = triangleCount == 0 ? 0.0f : static_cast<float>(misses) / triangleCount,
+        .atvr = referencedCount == 0 ? 0.0f : static_cast<float>(misses) / referencedCount,
+    };
+}
+
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<uint32_t> clusters;
+    if (triangleCount == 0)
+        return clusters;
+
+    TriangleAdjacencyObj adjacency;
+    adjacency.build(indices.data(), static_cast<uint32_t>(indices.size()), vertexCount);
+    std::vector<uint32_t> liveTriangles(vertexCount); // not emitted yet
+    for (uint32_t i{0}; i < vertexCount; ++i)
+    {
+        liveTriangles[i] = adjacency.count(i);
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    std::vector<uint32_t> deadEnds; // vertices of the emitted triangles, most recent on top
+    std::vector<uint32_t> candidates;
+    uint32_t time{cacheSize + 1};
+    uint32_t cursor{0};
+    int64_t fanning{0};
+    clusters.push_back(0);
+    while (fanning >= 0)
+    {
+        // emit every triangle left around the fanning vertex
+        candidates.clear();
+        for (uint32_t i{adjacency.offsets[fanning]}; i < adjacency.offsets[fanning + 1]; ++i)
+        {
+            uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+            for (uint32_t j{0}; j < 3; ++j)
+            {
+                uint32_t vertex = indices[3 * triangle + j];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (time - cacheTimes[vertex] > cacheSize)
+                    cacheTimes[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // the next fan is the vertex with triangles left that stays in the cache longest once they are emitted
+        int64_t next{-1};
+        int64_t best{-1};
+        for (uint32_t i{0}; i < candidates.size(); ++i)
+        {
+            uint32_t vertex = candidates[i];
+            if (liveTriangles[vertex] == 0)
+                continue;
+            int64_t priority{0};
+            if (time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - cacheTimes[vertex];
+            if (priority > best)
+            {
+                best = priority;
+                next = vertex;
+            }
+        }
+        if (next >= 0)
+        {
+            fanning = next;
+            continue;
+        }
+
+        // dead end, the most recent vertex with triangles left or else the first one in index order
+        while (!deadEnds.empty() && next < 0)
+        {
+            if (liveTriangles[deadEnds.back()] > 0)
+                next = deadEnds.back();
+            deadEnds.pop_back();
+        }
+        while (next < 0 && cursor < vertexCount)
+        {
+            if (liveTriangles[cursor] > 0)
+                next = cursor;
+            cursor++;
+        }
+        if (next >= 0 && result.size() / 3 != clusters.back())
+            clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+        fanning = next;
+    }
+    indices = std::move(result);
+    return clusters;
+}
+
+// the soft boundaries inside [first, last) where the acmr of the triangles since the previous boundary is within
+// threshold times the one of the whole cluster
+static void splitCluster(const std::vector<uint32_t> &indices, uint32_t first, uint32_t last, float threshold,
+                         VertexCacheObj &cache, std::vector<uint32_t> &boundaries)
+{
+    cache.flush();
+    uint32_t misses{0};
+    for (uint32_t i{first}; i < last; ++i)
+    {
+        misses += cache.useTriangle(&indices[3 * i]);
+    }
+    float limit = threshold * static_cast<float>(misses) / (last - first);
+
+    boundaries.push_back(first);
+    cache.flush();
+    misses = 0;
+    uint32_t start{first};
+    for (uint32_t i{first}; i < last; ++i)
+    {
+        misses += cache.useTriangle(&indices[3 * i]);
+        if (i + 1 < last && static_cast<float>(misses) / (i + 1 - start) <= limit)
+        {
+            start = i + 1;
+            boundaries.push_back(start);
+            cache.flush();
+            misses = 0;
+        }
+    }
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices,
+                      const std::vector<uint32_t> &clusters, float threshold, uint32_t cacheSize)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0 || clusters.empty())
+        return;
+
+    VertexCacheObj cache(static_cast<uint32_t>(vertices.size()), cacheSize);
+    std::vector<uint32_t> boundaries;
+    for (uint32_t i{0}; i < clusters.size(); ++i)
+    {
+        splitCluster(indices, clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : triangleCount, threshold,
+                     cache, boundaries);
+    }
+
+    // area weighted center and normal of the mesh and of every cluster
+    glm::vec3 meshCenter(0.0f);
+    float meshArea{0.0f};
+    std::vector<glm::vec3> centers(boundaries.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(boundaries.size(), glm::vec3(0.0f));
+    std::vector<float> areas(boundaries.size(), 0.0f);
+    for (uint32_t i{0}; i < boundaries.size(); ++i)
+    {
+        uint32_t last = i + 1 < boundaries.size() ? boundaries[i + 1] : triangleCount;
+        for (uint32_t j{boundaries[i]}; j < last; ++j)
+        {
+            const glm::vec3 &a = vertices[indices[3 * j]].pos;
+            const glm::vec3 &b = vertices[indices[3 * j + 1]].pos;
+            const glm::vec3 &c = vertices[indices[3 * j + 2]].pos;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+            centers[i] += (a + b + c) * (area / 3.0f);
+            normals[i] += normal;
+            areas[i] += area;
+        }
+        meshCenter += centers[i];
+        meshArea += areas[i];
+        centers[i] = areas[i] > 0.0f ? centers[i] / areas[i] : centers[i];
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+
+    std::vector<float> measures(boundaries.size());
+    std::vector<uint32_t> order(boundaries.size());
+    for (uint32_t i{0}; i < boundaries.size(); ++i)
+    {
+        float length = glm::length(normals[i]);
+        measures[i] = length > 0.0f ? glm::dot(centers[i] - meshCenter, normals[i] / length) : 0.0f;
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t left, uint32_t right) { return measures[left] > measures[right]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t i{0}; i < order.size(); ++i)
+    {
+        uint32_t first = boundaries[order[i]];
+        uint32_t last = order[i] + 1 < boundaries.size() ? boundaries[order[i] + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + 3 * first, indices.begin() + 3 * last);
+    }
+    indices = std::move(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (uint32_t i{0}; i < indices.size(); ++i)
+    {
+        if (remap[indices[i]] == UINT32_MAX)
+        {
+            remap[indices[i]] = static_cast<uint32_t>(result.size());
+            result.push_back(vertices[indices[i]]);
+        }
+        indices[i] = remap[indices[i]];
+    }
+    vertices = std::move(result);
+}
+
+MeshOptimizeStats optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, uint32_t cacheSize)
+{
+    MeshOptimizeStats stats;
+    stats.before = analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()), cacheSize);
+    if (indices.size() % 3 == 0)
+    {
+        std::vector<uint32_t> clusters = optimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()), cacheSize);
+        optimizeOverdraw(indices, vertices, clusters, 1.05f, cacheSize);
+        optimizeVertexFetch(vertices, indices);
+    }
+    stats.after = analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()), cacheSize);
+    return stats;
+}
+
+} // namespace Cthovk
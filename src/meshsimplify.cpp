@@ -0,0 +1,275 @@
+#include "../headers/meshsimplify.h"
+
+namespace Cthovk
+{
+
+// weighted sum of squared distances to a set of planes, p A p + 2 b p + c
+struct QuadricObj
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+
+    // the plane holds the points p with dot(normal, p) + distance = 0, normal is of unit length
+    void addPlane(glm::vec3 normal, float distance, double planeWeight)
+    {
+        double x = normal.x;
+        double y = normal.y;
+        double z = normal.z;
+        a00 += planeWeight * x * x;
+        a01 += planeWeight * x * y;
+        a02 += planeWeight * x * z;
+        a11 += planeWeight * y * y;
+        a12 += planeWeight * y * z;
+        a22 += planeWeight * z * z;
+        b0 += planeWeight * x * distance;
+        b1 += planeWeight * y * distance;
+        b2 += planeWeight * z * distance;
+        c += planeWeight * distance * distance;
+        weight += planeWeight;
+    }
+
+    void add(const QuadricObj &other)
+    {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    double evaluate(glm::vec3 p) const
+    {
+        double x = p.x;
+        double y = p.y;
+        double z = p.z;
+        return a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+               2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    }
+};
+
+// one way to remove an edge, from moves onto to
+struct EdgeCollapse
+{
+    float error; // mean squared distance to the planes of both ends
+    uint32_t from;
+    uint32_t to;
+};
+
+static const double borderWeight{10.0};
+
+// error of the merged quadrics of both ends at p, given the error of each end on its own there
+static float collapseError(double first, double second, double weight)
+{
+    return weight > 0.0 ? static_cast<float>(std::max(first + second, 0.0) / weight) : 0.0f;
+}
+
+// orders the collapses by error with two passes of a 16 bit radix sort, the bits of a positive float sort like it
+static void sortCollapses(std::vector<EdgeCollapse> &collapses, std::vector<EdgeCollapse> &scratch,
+                          std::vector<uint32_t> &counts)
+{
+    scratch.resize(collapses.size());
+    for (uint32_t shift{0}; shift < 32; shift += 16)
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (uint32_t i{0}; i < collapses.size(); ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, &collapses[i].error, sizeof(bits));
+            counts[(bits >> shift) & 0xffff]++;
+        }
+        uint32_t offset{0};
+        for (uint32_t i{0}; i < counts.size(); ++i)
+        {
+            uint32_t count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+        for (uint32_t i{0}; i < collapses.size(); ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, &collapses[i].error, sizeof(bits));
+            scratch[counts[(bits >> shift) & 0xffff]++] = collapses[i];
+        }
+        collapses.swap(scratch);
+    }
+}
+
+// true when moving from onto to turns one of the triangles around from that stay over
+static bool flips(const Vertex *vertices, const std::vector<uint32_t> &indices, const TriangleAdjacencyObj &adjacency,
+                  uint32_t from, uint32_t to)
+{
+    for (uint32_t i{adjacency.offsets[from]}; i < adjacency.offsets[from + 1]; ++i)
+    {
+        const uint32_t *triangle = &indices[3 * adjacency.triangles[i]];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (uint32_t j{0}; j < 3; ++j)
+        {
+            before[j] = vertices[triangle[j]].pos;
+            after[j] = triangle[j] == from ? vertices[to].pos : before[j];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalBefore) > 0.0f && glm::dot(normalBefore, normalAfter) <= 0.0f)
+            return true;
+    }
+    return false;
+}
+
+std::vector<uint32_t> simplifyMesh(const Vertex *vertices, uint32_t vertexCount, const std::vector<uint32_t> &indices,
+                                   uint32_t targetIndexCount, float &error)
+{
+    // vertices differing only in color are one corner of the surface
+    std::vector<uint32_t> remap(vertexCount);
+    std::iota(remap.begin(), remap.end(), 0);
+    std::vector<uint32_t> byPosition(remap);
+    std::stable_sort(byPosition.begin(), byPosition.end(), [&](uint32_t left, uint32_t right) {
+        const glm::vec3 &a = vertices[left].pos;
+        const glm::vec3 &b = vertices[right].pos;
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    });
+    for (uint32_t i{1}; i < vertexCount; ++i)
+    {
+        if (vertices[byPosition[i]].pos == vertices[byPosition[i - 1]].pos)
+            remap[byPosition[i]] = remap[byPosition[i - 1]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t i{0}; i + 2 < indices.size(); i += 3)
+    {
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i + 1]];
+        uint32_t c = remap[indices[i + 2]];
+        if (a != b && b != c && a != c)
+            result.insert(result.end(), {a, b, c});
+    }
+
+    // the planes of the triangles around every vertex weighted by their area, edges of a single triangle keep the
+    // border in place with a plane standing on them
+    TriangleAdjacencyObj adjacency;
+    adjacency.build(result.data(), static_cast<uint32_t>(result.size()), vertexCount);
+    std::vector<QuadricObj> quadrics(vertexCount, QuadricObj{});
+    for (uint32_t i{0}; i < result.size(); i += 3)
+    {
+        const glm::vec3 &a = vertices[result[i]].pos;
+        glm::vec3 normal = glm::cross(vertices[result[i + 1]].pos - a, vertices[result[i + 2]].pos - a);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normal /= length;
+        for (uint32_t j{0}; j < 3; ++j)
+        {
+            quadrics[result[i + j]].addPlane(normal, -glm::dot(normal, a), 0.5 * length);
+        }
+        for (uint32_t j{0}; j < 3; ++j)
+        {
+            uint32_t from = result[i + j];
+            uint32_t to = result[i + (j + 1) % 3];
+            uint32_t sharing{0};
+            for (uint32_t k{adjacency.offsets[from]}; k < adjacency.offsets[from + 1]; ++k)
+            {
+                const uint32_t *triangle = &result[3 * adjacency.triangles[k]];
+                sharing += triangle[0] == to || triangle[1] == to || triangle[2] == to;
+            }
+            if (sharing != 1)
+                continue;
+            glm::vec3 edge = vertices[to].pos - vertices[from].pos;
+            glm::vec3 border = glm::cross(edge, normal);
+            float borderLength = glm::length(border);
+            if (borderLength == 0.0f)
+                continue;
+            border /= borderLength;
+            double borderPlaneWeight = borderWeight * glm::dot(edge, edge);
+            quadrics[from].addPlane(border, -glm::dot(border, vertices[from].pos), borderPlaneWeight);
+            quadrics[to].addPlane(border, -glm::dot(border, vertices[from].pos), borderPlaneWeight);
+        }
+    }
+
+    // every pass collapses the cheapest edges that do not touch each other, each collapse removes up to two
+    // triangles
+    std::vector<uint32_t> collapses(vertexCount);
+    std::iota(collapses.begin(), collapses.end(), 0);
+    std::vector<bool> locked(vertexCount);
+    std::vector<double> ownErrors(vertexCount); // of every quadric at its own vertex
+    std::vector<EdgeCollapse> candidates;
+    std::vector<EdgeCollapse> scratch;
+    std::vector<uint32_t> counts(1u << 16);
+    float maxError{0.0f};
+    while (result.size() > targetIndexCount)
+    {
+        for (uint32_t i{0}; i < result.size(); ++i)
+        {
+            ownErrors[result[i]] = quadrics[result[i]].evaluate(vertices[result[i]].pos);
+        }
+        // edges between two triangles come up twice, the second one finds its ends locked
+        candidates.clear();
+        for (uint32_t i{0}; i < result.size(); ++i)
+        {
+            uint32_t a = result[i];
+            uint32_t b = result[i - i % 3 + (i + 1) % 3];
+            double weight = quadrics[a].weight + quadrics[b].weight;
+            float ontoA = collapseError(ownErrors[a], quadrics[b].evaluate(vertices[a].pos), weight);
+            float ontoB = collapseError(quadrics[a].evaluate(vertices[b].pos), ownErrors[b], weight);
+            candidates.push_back(ontoB <= ontoA ? EdgeCollapse{ontoB, a, b} : EdgeCollapse{ontoA, b, a});
+        }
+        sortCollapses(candidates, scratch, counts);
+
+        uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+        uint32_t collapseLimit = (triangleCount - targetIndexCount / 3) / 2 + 1;
+        uint32_t collapsed{0};
+        std::fill(locked.begin(), locked.end(), false);
+        for (uint32_t i{0}; i < candidates.size() && collapsed < collapseLimit; ++i)
+        {
+            const EdgeCollapse &candidate = candidates[i];
+            if (locked[candidate.from] || locked[candidate.to] ||
+                flips(vertices, result, adjacency, candidate.from, candidate.to))
+                continue;
+            // the triangles around from change, none of their vertices moves again in this pass
+            for (uint32_t j{adjacency.offsets[candidate.from]}; j < adjacency.offsets[candidate.from + 1]; ++j)
+            {
+                for (uint32_t k{0}; k < 3; ++k)
+                {
+                    locked[result[3 * adjacency.triangles[j] + k]] = true;
+                }
+            }
+            locked[candidate.to] = true;
+            collapses[candidate.from] = candidate.to;
+            quadrics[candidate.to].add(quadrics[candidate.from]);
+            maxError = std::max(maxError, candidate.error);
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        uint32_t kept{0};
+        for (uint32_t i{0}; i < result.size(); i += 3)
+        {
+            uint32_t a = collapses[result[i]];
+            uint32_t b = collapses[result[i + 1]];
+            uint32_t c = collapses[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[3 * kept] = a;
+            result[3 * kept + 1] = b;
+            result[3 * kept + 2] = c;
+            kept++;
+        }
+        result.resize(3 * kept);
+        adjacency.build(result.data(), static_cast<uint32_t>(result.size()), vertexCount);
+    }
+    error = std::sqrt(maxError);
+    return result;
+}
+
+} // namespace Cthovk
@@ -0,0 +1,446 @@
+#include "../headers/objimport.h"
+
+namespace Cthovk
+{
+
+// bytes of obj text below which a chunk is not split further
+static const size_t minChunkSize{1 << 16};
+// relative face indices are stored below zero until the chunk knows how many positions came before it
+static const int64_t RELATIVE{int64_t(1) << 40};
+
+struct ObjChunk
+{
+    const char *begin;
+    const char *end;
+    std::vector<Vertex> positions; // color holds the one of the file
+    std::vector<int64_t> corners;  // 0 based, see RELATIVE
+    std::vector<uint32_t> faceSizes;
+    std::vector<uint32_t> triangles; // position of every triangle corner
+    uint32_t firstPosition{0};
+    uint64_t firstCorner{0};
+    bool colors{false};
+};
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// the number parser of tinyobjloader, rounding like it keeps the parsed positions identical
+static bool parseDouble(const char *s, const char *end, double &result)
+{
+    double mantissa{0.0};
+    int exponent{0};
+    bool negative{false};
+    const char *current = s;
+    int read{0};
+    if (current == end)
+        return false;
+    if (*current == '+' || *current == '-')
+    {
+        negative = *current == '-';
+        current++;
+    }
+    else if (!isDigit(*current) && *current != '.')
+    {
+        return false;
+    }
+
+    if (current == end || *current != '.')
+    {
+        for (; current != end && isDigit(*current); ++current, ++read)
+        {
+            mantissa = mantissa * 10 + static_cast<int>(*current - '0');
+        }
+        if (read == 0)
+            return false;
+    }
+    if (current != end && *current == '.')
+    {
+        static const double powers[]{1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+        read = 1;
+        for (++current; current != end && isDigit(*current); ++current, ++read)
+        {
+            mantissa += static_cast<int>(*current - '0') * (read < 8 ? powers[read] : std::pow(10.0, -read));
+        }
+    }
+    if (current != end && (*current == 'e' || *current == 'E'))
+    {
+        bool negativeExponent{false};
+        ++current;
+        if (current != end && (*current == '+' || *current == '-'))
+        {
+            negativeExponent = *current == '-';
+            current++;
+        }
+        read = 0;
+        for (; current != end && isDigit(*current); ++current, ++read)
+        {
+            if (exponent > 2147483647 / 10)
+                return false;
+            exponent = exponent * 10 + static_cast<int>(*current - '0');
+        }
+        if (read == 0)
+            return false;
+        exponent = negativeExponent ? -exponent : exponent;
+    }
+    result = (negative ? -1 : 1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+// a missing or malformed number reads as fallback
+static bool parseReal(const char *&s, const char *end, float &value, float fallback)
+{
+    while (s != end && isSpace(*s))
+        s++;
+    const char *token = s;
+    while (s != end && !isSpace(*s) && *s != '\r' && *s != '\n')
+        s++;
+    double parsed{fallback};
+    bool valid = parseDouble(token, s, parsed);
+    value = static_cast<float>(parsed);
+    return valid;
+}
+
+static void parseVertex(const char *&s, const char *end, ObjChunk &chunk)
+{
+    Vertex vertex;
+    parseReal(s, end, vertex.pos.x, 0.0f);
+    parseReal(s, end, vertex.pos.y, 0.0f);
+    parseReal(s, end, vertex.pos.z, 0.0f);
+    if (parseReal(s, end, vertex.color.x, 1.0f) && parseReal(s, end, vertex.color.y, 1.0f) &&
+        parseReal(s, end, vertex.color.z, 1.0f))
+        chunk.colors = true;
+    else
+        vertex.color = glm::vec3(1.0f);
+    chunk.positions.push_back(vertex);
+}
+
+// only the position of every v, v/vt, v//vn or v/vt/vn corner is kept
+static void parseFace(const char *&s, const char *end, ObjChunk &chunk)
+{
+    uint32_t size{0};
+    while (true)
+    {
+        while (s != end && (isSpace(*s) || *s == '\r'))
+            s++;
+        if (s == end || *s == '\n')
+            break;
+        bool negative = *s == '-';
+        if (*s == '-' || *s == '+')
+            s++;
+        int64_t index{0};
+        for (; s != end && isDigit(*s); ++s)
+        {
+            index = std::min<int64_t>(index * 10 + (*s - '0'), RELATIVE / 2);
+        }
+        if (index == 0)
+            throw std::runtime_error("invalid face index in obj file");
+        int64_t local = static_cast<int64_t>(chunk.positions.size());
+        chunk.corners.push_back(negative ? local - index - RELATIVE : index - 1);
+        size++;
+        while (s != end && !isSpace(*s) && *s != '\r' && *s != '\n')
+            s++;
+    }
+    chunk.faceSizes.push_back(size);
+}
+
+static void parseChunk(ObjChunk &chunk)
+{
+    const char *s = chunk.begin;
+    while (s != chunk.end)
+    {
+        while (s != chunk.end && isSpace(*s))
+            s++;
+        if (chunk.end - s > 1 && s[0] == 'v' && isSpace(s[1]))
+            parseVertex(s += 2, chunk.end, chunk);
+        else if (chunk.end - s > 1 && s[0] == 'f' && isSpace(s[1]))
+            parseFace(s += 2, chunk.end, chunk);
+        while (s != chunk.end && *s++ != '\n')
+        {
+        }
+    }
+}
+
+// resolves the corners against every position of the file and splits the faces into triangles
+static void triangulateChunk(ObjChunk &chunk, const std::vector<const ObjChunk *> &chunks, uint32_t positionCount)
+{
+    auto position = [&](uint32_t index) -> const glm::vec3 & {
+        // the owning chunk is found by the first position of the chunks
+        uint32_t low{0};
+        uint32_t high = static_cast<uint32_t>(chunks.size());
+        while (high - low > 1)
+        {
+            uint32_t middle = (low + high) / 2;
+            if (chunks[middle]->firstPosition <= index)
+                low = middle;
+            else
+                high = middle;
+        }
+        return chunks[low]->positions[index - chunks[low]->firstPosition].pos;
+    };
+
+    std::vector<uint32_t> face;
+    size_t corner{0};
+    for (uint32_t i{0}; i < chunk.faceSizes.size(); ++i)
+    {
+        face.resize(chunk.faceSizes[i]);
+        for (uint32_t j{0}; j < face.size(); ++j, ++corner)
+        {
+            int64_t index = chunk.corners[corner];
+            if (index < 0)
+                index += RELATIVE + chunk.firstPosition;
+            if (index < 0 || index >= positionCount)
+                throw std::runtime_error("face index out of range in obj file");
+            face[j] = static_cast<uint32_t>(index);
+        }
+        if (face.size() < 3)
+            continue;
+        if (face.size() == 4)
+        {
+            // cut along the shorter diagonal
+            glm::vec3 diagonal02 = position(face[2]) - position(face[0]);
+            glm::vec3 diagonal13 = position(face[3]) - position(face[1]);
+            float length02 = diagonal02.x * diagonal02.x + diagonal02.y * diagonal02.y + diagonal02.z * diagonal02.z;
+            float length13 = diagonal13.x * diagonal13.x + diagonal13.y * diagonal13.y + diagonal13.z * diagonal13.z;
+            uint32_t quad[6]{face[0], face[1], face[2], face[0], face[2], face[3]};
+            if (!(length02 < length13))
+                quad[2] = face[3], quad[3] = face[1];
+            chunk.triangles.insert(chunk.triangles.end(), quad, quad + 6);
+            continue;
+        }
+        for (uint32_t j{1}; j + 1 < face.size(); ++j)
+        {
+            chunk.triangles.push_back(face[0]);
+            chunk.triangles.push_back(face[j]);
+            chunk.triangles.push_back(face[j + 1]);
+        }
+    }
+    chunk.corners = {};
+}
+
+static uint64_t mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+// equal vertices hash equally, -0.0 included
+static uint64_t hashVertex(const Vertex &vertex)
+{
+    float values[6]{vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.color.x, vertex.color.y, vertex.color.z};
+    uint64_t hash{0x9e3779b97f4a7c15ull};
+    for (uint32_t i{0}; i < 6; i += 2)
+    {
+        float low = values[i] + 0.0f;
+        float high = values[i + 1] + 0.0f;
+        uint32_t lowBits, highBits;
+        memcpy(&lowBits, &low, sizeof(lowBits));
+        memcpy(&highBits, &high, sizeof(highBits));
+        hash = mix(hash ^ ((uint64_t(highBits) << 32) | lowBits));
+    }
+    return hash;
+}
+
+void importObj(const std::string &location, WorkerPool &workers, std::vector<Vertex> &vertices,
+               std::vector<uint32_t> &indices, const std::function<glm::vec3(const glm::vec3 &pos)> &colorize)
+{
+    vertices.clear();
+    indices.clear();
+    int descriptor = open(location.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw std::runtime_error("failed to open obj file: " + location);
+    struct stat status;
+    size_t size = fstat(descriptor, &status) == 0 ? static_cast<size_t>(status.st_size) : 0;
+    void *mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+    close(descriptor);
+    if (size == 0)
+        return;
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("failed to map obj file: " + location);
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    // every chunk starts at the beginning of a line
+    const char *text = static_cast<const char *>(mapping);
+    uint32_t chunkCount = static_cast<uint32_t>(std::min<size_t>(size / minChunkSize + 1, 8 * workers.size()));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char *begin = text;
+    for (uint32_t i{0}; i < chunkCount; ++i)
+    {
+        const char *end = i + 1 == chunkCount ? text + size : text + size * (i + 1) / chunkCount;
+        end = end < begin ? begin : end;
+        const char *newline = static_cast<const char *>(memchr(end, '\n', text + size - end));
+        chunks[i].begin = begin;
+        chunks[i].end = newline != nullptr ? newline + 1 : text + size;
+        begin = chunks[i].end;
+    }
+
+    try
+    {
+        workers.run([&](uint32_t task) { parseChunk(chunks[task]); }, chunkCount);
+
+        // positions and triangle corners of a chunk follow the ones of the chunks before it
+        uint64_t positionCount{0};
+        std::vector<const ObjChunk *> owners(chunkCount);
+        for (uint32_t i{0}; i < chunkCount; ++i)
+        {
+            chunks[i].firstPosition = static_cast<uint32_t>(positionCount);
+            positionCount += chunks[i].positions.size();
+            owners[i] = &chunks[i];
+        }
+        if (positionCount >= UINT32_MAX)
+            throw std::runtime_error("too many positions in obj file: " + location);
+        workers.run([&](uint32_t task) { triangulateChunk(chunks[task], owners, positionCount); }, chunkCount);
+        uint64_t cornerCount{0};
+        for (uint32_t i{0}; i < chunkCount; ++i)
+        {
+            chunks[i].firstCorner = cornerCount;
+            cornerCount += chunks[i].triangles.size();
+        }
+        if (cornerCount >= UINT32_MAX)
+            throw std::runtime_error("too many faces in obj file: " + location);
+        munmap(mapping, size);
+        mapping = MAP_FAILED;
+
+        // the flat arrays below are split into ranges, a few per thread
+        uint32_t taskCount = 4 * workers.size();
+        auto forRanges = [&](uint64_t count, const std::function<void(uint32_t task, uint32_t first, uint32_t last)> &job) {
+            workers.run(
+                [&](uint32_t task) {
+                    job(task, static_cast<uint32_t>(count * task / taskCount),
+                        static_cast<uint32_t>(count * (task + 1) / taskCount));
+                },
+                taskCount);
+        };
+
+        // the vertex of every position, colored once
+        std::vector<Vertex> candidates(positionCount);
+        workers.run(
+            [&](uint32_t task) {
+                const ObjChunk &chunk = chunks[task];
+                for (uint32_t i{0}; i < chunk.positions.size(); ++i)
+                {
+                    candidates[chunk.firstPosition + i] = chunk.positions[i];
+                    if (colorize)
+                        candidates[chunk.firstPosition + i].color = colorize(chunk.positions[i].pos);
+                }
+            },
+            chunkCount);
+        std::vector<uint32_t> triangles(cornerCount);
+        workers.run(
+            [&](uint32_t task) {
+                std::copy(chunks[task].triangles.begin(), chunks[task].triangles.end(),
+                          triangles.begin() + chunks[task].firstCorner);
+                chunks[task] = {};
+            },
+            chunkCount);
+
+        // open addressing table of the lowest position holding every distinct vertex, 0 is an empty slot
+        uint64_t capacity{1};
+        while (capacity < 2 * positionCount)
+            capacity *= 2;
+        std::vector<std::atomic<uint32_t>> table(capacity);
+        std::vector<uint32_t> canonical(positionCount);
+        forRanges(positionCount, [&](uint32_t, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                for (uint64_t slot = hashVertex(candidates[i]) & (capacity - 1);; slot = (slot + 1) & (capacity - 1))
+                {
+                    // a failed exchange leaves the vertex that claimed the slot meanwhile in entry
+                    uint32_t entry = table[slot].load(std::memory_order_acquire);
+                    if (entry == 0 && table[slot].compare_exchange_strong(entry, i + 1, std::memory_order_acq_rel))
+                        break;
+                    if (entry != 0 && candidates[entry - 1] == candidates[i])
+                    {
+                        while (i + 1 < entry &&
+                               !table[slot].compare_exchange_weak(entry, i + 1, std::memory_order_acq_rel))
+                        {
+                        }
+                        break;
+                    }
+                }
+            }
+        });
+        forRanges(positionCount, [&](uint32_t, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                uint64_t slot = hashVertex(candidates[i]) & (capacity - 1);
+                uint32_t entry = table[slot].load(std::memory_order_relaxed);
+                while (entry - 1 != i && !(candidates[entry - 1] == candidates[i]))
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                    entry = table[slot].load(std::memory_order_relaxed);
+                }
+                canonical[i] = entry - 1;
+            }
+        });
+        std::vector<std::atomic<uint32_t>>().swap(table);
+
+        // a vertex is numbered by the corner that uses it first, like inserting the corners in order would
+        std::vector<std::atomic<uint32_t>> firstUse(positionCount);
+        forRanges(positionCount, [&](uint32_t, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                firstUse[i].store(UINT32_MAX, std::memory_order_relaxed);
+            }
+        });
+        forRanges(cornerCount, [&](uint32_t, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                std::atomic<uint32_t> &use = firstUse[canonical[triangles[i]]];
+                uint32_t seen = use.load(std::memory_order_relaxed);
+                while (i < seen && !use.compare_exchange_weak(seen, i, std::memory_order_relaxed))
+                {
+                }
+            }
+        });
+        std::vector<uint32_t> firstCounts(taskCount + 1, 0);
+        forRanges(cornerCount, [&](uint32_t task, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                firstCounts[task + 1] += firstUse[canonical[triangles[i]]].load(std::memory_order_relaxed) == i;
+            }
+        });
+        for (uint32_t i{0}; i < taskCount; ++i)
+        {
+            firstCounts[i + 1] += firstCounts[i];
+        }
+        vertices.resize(firstCounts[taskCount]);
+        std::vector<uint32_t> numbers(positionCount);
+        forRanges(cornerCount, [&](uint32_t task, uint32_t first, uint32_t last) {
+            uint32_t next = firstCounts[task];
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                uint32_t vertex = canonical[triangles[i]];
+                if (firstUse[vertex].load(std::memory_order_relaxed) != i)
+                    continue;
+                numbers[vertex] = next;
+                vertices[next++] = candidates[vertex];
+            }
+        });
+        indices.resize(cornerCount);
+        forRanges(cornerCount, [&](uint32_t, uint32_t first, uint32_t last) {
+            for (uint32_t i{first}; i < last; ++i)
+            {
+                indices[i] = numbers[canonical[triangles[i]]];
+            }
+        });
+    }
+    catch (...)
+    {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, size);
+        throw;
+    }
+}
+
+} // namespace Cthovk
@@ -0,0 +1,183 @@
+#include "../headers/pipelinecache.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+// the Vulkan cache header carries no driver version, so the blob is wrapped in one that does
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint32_t reserved; // zero, keeps dataSize aligned without padding bytes of unknown value in the file
+    uint64_t dataSize;
+    uint64_t checksum;
+};
+static_assert(sizeof(PipelineCacheFileHeader) == 56, "the file header has padding bytes");
+
+static constexpr uint32_t CACHE_MAGIC{0x43505643}; // "CVPC"
+static constexpr uint32_t CACHE_VERSION{1};
+
+static uint64_t checksum(const char *data, size_t size)
+{
+    // FNV-1a, only meant to catch truncated or corrupted files
+    uint64_t hash{0xcbf29ce484222325ull};
+    for (size_t i{0}; i < size; ++i)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+PipelineCacheObj::PipelineCacheObj(VkDevice logDevice, VkPhysicalDevice phyDevice, std::string location,
+                                   bool feedback)
+    : logDevice(logDevice), location(location), feedback(feedback)
+{
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+
+    std::vector<char> data;
+    stats.loaded = !location.empty() && load(data);
+    VkPipelineCacheCreateInfo cacheInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = stats.loaded ? data.size() : 0,
+        .pInitialData = stats.loaded ? data.data() : nullptr,
+    };
+    if (vkCreatePipelineCache(logDevice, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+    {
+        // the driver may still refuse a blob that passed validation, start over with an empty cache
+        stats.loaded = false;
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        vkCheck(vkCreatePipelineCache(logDevice, &cacheInfo, nullptr, &cache), "failed to create pipeline cache");
+    }
+    stats.loadedBytes = stats.loaded ? data.size() : 0;
+}
+
+bool PipelineCacheObj::load(std::vector<char> &data)
+{
+    std::ifstream file(location, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    size_t fileSize = (size_t)file.tellg();
+    PipelineCacheFileHeader header;
+    if (fileSize < sizeof(header))
+        return false;
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.vendorID != properties.vendorID ||
+        header.deviceID != properties.deviceID || header.driverVersion != properties.driverVersion ||
+        std::memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+        header.dataSize != fileSize - sizeof(header))
+        return false;
+
+    data.resize(header.dataSize);
+    file.read(data.data(), data.size());
+    if (!file || checksum(data.data(), data.size()) != header.checksum)
+        return false;
+
+    // the blob has to agree with its own header too, drivers are not required to validate it
+    VkPipelineCacheHeaderVersionOne cacheHeader;
+    if (data.size() < sizeof(cacheHeader))
+        return false;
+    std::memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+    return cacheHeader.headerSize >= sizeof(cacheHeader) &&
+           cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           cacheHeader.vendorID == properties.vendorID && cacheHeader.deviceID == properties.deviceID &&
+           std::memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipeline PipelineCacheObj::createGraphicsPipeline(VkGraphicsPipelineCreateInfo pipelineInfo)
+{
+    return createPipeline(pipelineInfo.pNext, [&](const void *pNext, VkPipeline *pipeline) {
+        pipelineInfo.pNext = pNext;
+        return vkCreateGraphicsPipelines(logDevice, cache, 1, &pipelineInfo, nullptr, pipeline);
+    });
+}
+
+VkPipeline PipelineCacheObj::createComputePipeline(VkComputePipelineCreateInfo pipelineInfo)
+{
+    return createPipeline(pipelineInfo.pNext, [&](const void *pNext, VkPipeline *pipeline) {
+        pipelineInfo.pNext = pNext;
+        return vkCreateComputePipelines(logDevice, cache, 1, &pipelineInfo, nullptr, pipeline);
+    });
+}
+
+VkPipeline PipelineCacheObj::createPipeline(
+    const void *pNext, const std::function<VkResult(const void *pNext, VkPipeline *pipeline)> &create)
+{
+    VkPipelineCreationFeedbackEXT pipelineFeedback{};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = pNext,
+        .pPipelineCreationFeedback = &pipelineFeedback,
+        .pipelineStageCreationFeedbackCount = 0,
+        .pPipelineStageCreationFeedbacks = nullptr,
+    };
+
+    VkPipeline pipeline;
+    auto start = std::chrono::steady_clock::now();
+    vkCheck(create(feedback ? &feedbackInfo : pNext, &pipeline), "failed to create pipeline");
+    auto duration = std::chrono::steady_clock::now() - start;
+    stats.creationTime += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+
+    if (!(pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+        stats.unknown++;
+    else if (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+        stats.hits++;
+    else
+        stats.misses++;
+    return pipeline;
+}
+
+bool PipelineCacheObj::save()
+{
+    if (location.empty())
+        return false;
+    size_t dataSize{0};
+    if (vkGetPipelineCacheData(logDevice, cache, &dataSize, nullptr) != VK_SUCCESS)
+        return false;
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(logDevice, cache, &dataSize, data.data()) != VK_SUCCESS)
+        return false;
+    data.resize(dataSize);
+
+    PipelineCacheFileHeader header{
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+        .driverVersion = properties.driverVersion,
+        .reserved = 0,
+        .dataSize = data.size(),
+        .checksum = checksum(data.data(), data.size()),
+    };
+    std::memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // flushed to the disk before the rename, otherwise a crash may leave the new name pointing at missing data
+    std::string temporary = location + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(data.data(), 1, data.size(), file) == data.size() && std::fflush(file) == 0 &&
+                   fsync(fileno(file)) == 0;
+    if (std::fclose(file) != 0 || !written)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return std::rename(temporary.c_str(), location.c_str()) == 0;
+}
+
+PipelineCacheObj::~PipelineCacheObj()
+{
+    save();
+    vkDestroyPipelineCache(logDevice, cache, nullptr);
+}
+
+} // namespace Cthovk
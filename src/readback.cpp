@@ -0,0 +1,260 @@
+#include "../headers/readback.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+static VkDeviceSize texelSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        throw std::runtime_error("unsupported readback format");
+    }
+}
+
+ReadbackObj::ReadbackObj(VkDevice logDevice, VkPhysicalDevice phyDevice, MemoryAllocator &allocator,
+                         uint32_t queueFamily, uint32_t slotCount, VkFormat format, VkExtent2D extent,
+                         std::function<void(const ReadbackFrame &frame)> frameReadback)
+    : logDevice(logDevice), allocator(&allocator), frameReadback(frameReadback), slots(slotCount)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+    atomSize = properties.limits.nonCoherentAtomSize;
+    // host visible memory is only guaranteed to come coherent, the invalidate in consume covers both
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memProperties);
+    hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
+    {
+        VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if ((memProperties.memoryTypes[i].propertyFlags & cached) == cached)
+            hostMemory = cached;
+    }
+
+    VkCommandPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+    vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &pool), "failed to create readback command pool");
+    VkCommandBufferAllocateInfo cbInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkFenceCreateInfo fenceInfo{
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    for (uint32_t i{0}; i < slotCount; ++i)
+    {
+        vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, &slots[i].commandBuffer),
+                "failed to create readback command buffer");
+        vkCheck(vkCreateFence(logDevice, &fenceInfo, nullptr, &slots[i].fence), "failed to create readback fence");
+    }
+    resize(format, extent);
+    consumer = std::thread(&ReadbackObj::consume, this);
+}
+
+void ReadbackObj::resize(VkFormat format, VkExtent2D extent)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&]() {
+        return std::none_of(slots.begin(), slots.end(), [](const Slot &slot) { return slot.submitted; });
+    });
+    VkDeviceSize size = texelSize(format) * extent.width * extent.height;
+    for (uint32_t i{0}; i < slots.size(); ++i)
+    {
+        if (slots[i].buffer != nullptr && slots[i].buffer->Count >= size)
+            continue;
+        delete slots[i].buffer;
+        slots[i].buffer = new BufferObj(logDevice, *allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory,
+                                        static_cast<uint32_t>(size));
+    }
+}
+
+uint32_t ReadbackObj::reserve()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+    if (slots[next].submitted)
+    {
+        dropped++;
+        return UINT32_MAX;
+    }
+    return next;
+}
+
+void ReadbackObj::capture(uint32_t slot, VkQueue queue, VkImage image, VkImageLayout layout, VkFormat format,
+                          VkExtent2D extent, uint64_t number, VkSemaphore signal)
+{
+    // the consumer is done with the slot, nothing else touches it until it is submitted again
+    Slot &target = slots[slot];
+    VkDeviceSize size = texelSize(format) * extent.width * extent.height;
+    if (target.buffer->Count < size)
+        throw std::runtime_error("captured a frame larger than ReadbackObj::resize was given");
+
+    VkCommandBuffer commandBuffer = target.commandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkCheck(vkBeginCommandBuffer(commandBuffer, &beginInfo), "failed to record readback buffer");
+
+    // the copy waits for the color writes of the frame, a multisampled frame is resolved by then
+    VkImageMemoryBarrier toTransfer{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = layout,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+    VkBufferImageCopy region{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {extent.width, extent.height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.buffer->buffer, 1,
+                           &region);
+
+    // the pixels become visible to the host once the fence signals, the image goes back to where it was
+    VkMemoryBarrier toHost{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    VkImageMemoryBarrier toLayout = toTransfer;
+    toLayout.srcAccessMask = 0;
+    toLayout.dstAccessMask = 0;
+    toLayout.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toLayout.newLayout = layout;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 1, &toHost, 0, nullptr,
+                         layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 1 : 0, &toLayout);
+    vkCheck(vkEndCommandBuffer(commandBuffer), "failed to record readback buffer");
+
+    target.frame = {
+        .data = target.buffer->memory.mapped,
+        .size = size,
+        .format = format,
+        .extent = extent,
+        .number = number,
+        .dropped = dropped,
+    };
+    vkResetFences(logDevice, 1, &target.fence);
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = signal != VK_NULL_HANDLE ? 1u : 0u,
+        .pSignalSemaphores = &signal,
+    };
+    vkCheck(vkQueueSubmit(queue, 1, &submitInfo, target.fence), "failed to submit readback");
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target.submitted = true;
+        next = (slot + 1) % slots.size();
+    }
+    wake.notify_one();
+}
+
+void ReadbackObj::consume()
+{
+    // slots are submitted and handed out in ring order
+    for (uint32_t current{0};; current = (current + 1) % slots.size())
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || slots[current].submitted; });
+            if (!slots[current].submitted)
+                return;
+        }
+        Slot &slot = slots[current];
+        vkWaitForFences(logDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+        // host cached memory is not necessarily coherent, the range runs from the atom the buffer starts in to the
+        // end of its memory
+        VkMappedMemoryRange range{
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = slot.buffer->memory.memory,
+            .offset = slot.buffer->memory.offset / atomSize * atomSize,
+            .size = VK_WHOLE_SIZE,
+        };
+        vkInvalidateMappedMemoryRanges(logDevice, 1, &range);
+        try
+        {
+            if (frameReadback)
+                frameReadback(slot.frame);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.submitted = false;
+        }
+        // resize waits for the slots to be handed out
+        wake.notify_all();
+    }
+}
+
+ReadbackObj::~ReadbackObj()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    consumer.join();
+    for (uint32_t i{0}; i < slots.size(); ++i)
+    {
+        vkDestroyFence(logDevice, slots[i].fence, nullptr);
+        delete slots[i].buffer;
+    }
+    vkDestroyCommandPool(logDevice, pool, nullptr);
+}
+
+} // namespace Cthovk
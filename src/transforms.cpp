@@ -0,0 +1,206 @@
+#include "../headers/transforms.h"
+
+namespace Cthovk
+{
+
+void TransformBatchObj::resize(uint32_t count)
+{
+    translationX.resize(count, 0.0f);
+    translationY.resize(count, 0.0f);
+    translationZ.resize(count, 0.0f);
+    rotationX.resize(count, 0.0f);
+    rotationY.resize(count, 0.0f);
+    rotationZ.resize(count, 0.0f);
+    rotationW.resize(count, 1.0f);
+    scaleX.resize(count, 1.0f);
+    scaleY.resize(count, 1.0f);
+    scaleZ.resize(count, 1.0f);
+    parents.resize(count, noParent);
+    firstChildren.resize(count, noParent);
+    nextSiblings.resize(count, noParent);
+    previousSiblings.resize(count, noParent);
+    // rebuilding the order never allocates
+    order.reserve(count);
+}
+
+void TransformBatchObj::set(uint32_t slot, glm::vec3 translation, glm::quat rotation, glm::vec3 scale)
+{
+    translationX[slot] = translation.x;
+    translationY[slot] = translation.y;
+    translationZ[slot] = translation.z;
+    rotationX[slot] = rotation.x;
+    rotationY[slot] = rotation.y;
+    rotationZ[slot] = rotation.z;
+    rotationW[slot] = rotation.w;
+    scaleX[slot] = scale.x;
+    scaleY[slot] = scale.y;
+    scaleZ[slot] = scale.z;
+}
+
+void TransformBatchObj::setParent(uint32_t slot, uint32_t parent)
+{
+    for (uint32_t ancestor{parent}; ancestor != noParent; ancestor = parents[ancestor])
+    {
+        if (ancestor == slot)
+            throw std::runtime_error("a transform can not be a parent of one of its ancestors");
+    }
+    if (parents[slot] == parent)
+        return;
+
+    // unlinked from the siblings it had and linked in front of the new ones
+    if (parents[slot] != noParent)
+    {
+        if (previousSiblings[slot] != noParent)
+            nextSiblings[previousSiblings[slot]] = nextSiblings[slot];
+        else
+            firstChildren[parents[slot]] = nextSiblings[slot];
+        if (nextSiblings[slot] != noParent)
+            previousSiblings[nextSiblings[slot]] = previousSiblings[slot];
+        childSlots--;
+    }
+    parents[slot] = parent;
+    previousSiblings[slot] = noParent;
+    nextSiblings[slot] = noParent;
+    if (parent != noParent)
+    {
+        nextSiblings[slot] = firstChildren[parent];
+        if (firstChildren[parent] != noParent)
+            previousSiblings[firstChildren[parent]] = slot;
+        firstChildren[parent] = slot;
+        childSlots++;
+    }
+    orderStale = true;
+}
+
+void TransformBatchObj::detach(uint32_t slot)
+{
+    while (firstChildren[slot] != noParent)
+    {
+        setParent(firstChildren[slot], noParent);
+    }
+    setParent(slot, noParent);
+}
+
+glm::mat4 TransformBatchObj::matrix(uint32_t slot) const
+{
+    float x = rotationX[slot];
+    float y = rotationY[slot];
+    float z = rotationZ[slot];
+    float w = rotationW[slot];
+    glm::mat4 model(1.0f);
+    model[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) *
+               scaleX[slot];
+    model[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) *
+               scaleY[slot];
+    model[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) *
+               scaleZ[slot];
+    model[3] = glm::vec4(translationX[slot], translationY[slot], translationZ[slot], 1.0f);
+    return model;
+}
+
+void TransformBatchObj::writeMatrices(uint32_t first, uint32_t last, void *destination, size_t stride) const
+{
+    char *bytes = static_cast<char *>(destination);
+    uint32_t i{first};
+#if defined(__SSE2__)
+    // every register holds one element of the matrices of four slots, transposing four of them turns them into one
+    // column of every slot
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    for (; i + 4 <= last; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&rotationX[i]);
+        __m128 y = _mm_loadu_ps(&rotationY[i]);
+        __m128 z = _mm_loadu_ps(&rotationZ[i]);
+        __m128 w = _mm_loadu_ps(&rotationW[i]);
+        __m128 xx = _mm_mul_ps(x, x);
+        __m128 yy = _mm_mul_ps(y, y);
+        __m128 zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z);
+        __m128 yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x);
+        __m128 wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+        __m128 sx = _mm_loadu_ps(&scaleX[i]);
+        __m128 sy = _mm_loadu_ps(&scaleY[i]);
+        __m128 sz = _mm_loadu_ps(&scaleZ[i]);
+        __m128 sx2 = _mm_mul_ps(sx, two);
+        __m128 sy2 = _mm_mul_ps(sy, two);
+        __m128 sz2 = _mm_mul_ps(sz, two);
+
+        __m128 columns[4][4]{
+            {
+                _mm_sub_ps(sx, _mm_mul_ps(_mm_add_ps(yy, zz), sx2)),
+                _mm_mul_ps(_mm_add_ps(xy, wz), sx2),
+                _mm_mul_ps(_mm_sub_ps(xz, wy), sx2),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_mul_ps(_mm_sub_ps(xy, wz), sy2),
+                _mm_sub_ps(sy, _mm_mul_ps(_mm_add_ps(xx, zz), sy2)),
+                _mm_mul_ps(_mm_add_ps(yz, wx), sy2),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_mul_ps(_mm_add_ps(xz, wy), sz2),
+                _mm_mul_ps(_mm_sub_ps(yz, wx), sz2),
+                _mm_sub_ps(sz, _mm_mul_ps(_mm_add_ps(xx, yy), sz2)),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_loadu_ps(&translationX[i]),
+                _mm_loadu_ps(&translationY[i]),
+                _mm_loadu_ps(&translationZ[i]),
+                one,
+            },
+        };
+        for (uint32_t c{0}; c < 4; ++c)
+        {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (uint32_t j{0}; j < 4; ++j)
+            {
+                _mm_storeu_ps(reinterpret_cast<float *>(bytes + stride * (i + j) + sizeof(glm::vec4) * c),
+                              columns[c][j]);
+            }
+        }
+    }
+#endif
+    for (; i < last; ++i)
+    {
+        glm::mat4 model = matrix(i);
+        memcpy(bytes + stride * i, &model, sizeof(model));
+    }
+}
+
+void TransformBatchObj::composeHierarchy(glm::mat4 *matrices)
+{
+    if (orderStale)
+    {
+        // breadth first from the roots, the slots of a level are appended while the level before is walked
+        order.clear();
+        for (uint32_t i{0}; i < parents.size(); ++i)
+        {
+            if (parents[i] != noParent)
+                continue;
+            for (uint32_t child{firstChildren[i]}; child != noParent; child = nextSiblings[child])
+            {
+                order.push_back(child);
+            }
+        }
+        for (uint32_t i{0}; i < order.size(); ++i)
+        {
+            for (uint32_t child{firstChildren[order[i]]}; child != noParent; child = nextSiblings[child])
+            {
+                order.push_back(child);
+            }
+        }
+        orderStale = false;
+    }
+    for (uint32_t i{0}; i < order.size(); ++i)
+    {
+        matrices[order[i]] = matrices[parents[order[i]]] * matrices[order[i]];
+    }
+}
+
+} // namespace Cthovk
@@ -0,0 +1,396 @@
+#include "../headers/upload.h"
+#include "../headers/vkcheck.h"
+
+namespace Cthovk
+{
+
+// every stage that may read an uploaded buffer in a later submission
+static const VkPipelineStageFlags consumerStages{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+static const VkAccessFlags consumerAccess{VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                          VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                                          VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+// destination ranges one submission changes the family of at most, further uploads go into the next submission so
+// the barriers of a submission fit into memory reserved up front
+static const uint32_t maxRegions{256};
+
+UploadBatchObj::UploadBatchObj(VkDevice logDevice, MemoryAllocator &allocator, uint32_t queueFamily, VkQueue queue,
+                               uint32_t dstFamily, VkQueue dstQueue, VkDeviceSize capacity, uint32_t maxSubmissions)
+    : logDevice(logDevice), queue(queue), dstQueue(dstQueue), queueFamily(queueFamily), dstFamily(dstFamily),
+      capacity(capacity), allocator(&allocator)
+{
+    if (capacity < 16)
+        throw std::runtime_error("the staging ring needs to hold at least 16 bytes");
+    VkBufferCreateInfo bInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = capacity,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    vkCheck(vkCreateBuffer(logDevice, &bInfo, nullptr, &staging), "failed to create staging buffer");
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(logDevice, staging, &memRequirements);
+    stagingMemory = allocator.allocate(memRequirements,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    vkCheck(vkBindBufferMemory(logDevice, staging, stagingMemory.memory, stagingMemory.offset),
+            "failed to bind staging buffer memory");
+
+    VkCommandPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+    vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &pool), "failed to create upload command pool");
+
+    submissions.resize(maxSubmissions);
+    std::vector<VkCommandBuffer> commandBuffers(maxSubmissions);
+    VkCommandBufferAllocateInfo cbInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = maxSubmissions,
+    };
+    vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, commandBuffers.data()),
+            "failed to create upload command buffers");
+    VkFenceCreateInfo fenceInfo{
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    for (uint32_t i{0}; i < maxSubmissions; ++i)
+    {
+        submissions[i].commandBuffer = commandBuffers[i];
+        vkCheck(vkCreateFence(logDevice, &fenceInfo, nullptr, &submissions[i].fence), "failed to create fence");
+    }
+
+    if (!ownershipTransfer())
+        return;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = dstFamily;
+    vkCheck(vkCreateCommandPool(logDevice, &poolInfo, nullptr, &dstPool), "failed to create acquire command pool");
+    cbInfo.commandPool = dstPool;
+    vkCheck(vkAllocateCommandBuffers(logDevice, &cbInfo, commandBuffers.data()),
+            "failed to create acquire command buffers");
+    VkSemaphoreCreateInfo semaphoreInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    barriers.reserve(maxRegions);
+    for (uint32_t i{0}; i < maxSubmissions; ++i)
+    {
+        submissions[i].regions.reserve(maxRegions);
+        submissions[i].acquireBuffer = commandBuffers[i];
+        vkCheck(vkCreateFence(logDevice, &fenceInfo, nullptr, &submissions[i].transferFence),
+                "failed to create fence");
+        vkCheck(vkCreateSemaphore(logDevice, &semaphoreInfo, nullptr, &submissions[i].semaphore),
+                "failed to create semaphore");
+    }
+}
+
+bool UploadBatchObj::ownershipTransfer() const
+{
+    return queueFamily != dstFamily;
+}
+
+bool UploadBatchObj::reserve(VkDeviceSize size, VkDeviceSize &offset, VkDeviceSize &consumed)
+{
+    if (used == 0)
+    {
+        head = 0;
+        tail = 0;
+    }
+    else if (head % capacity == tail)
+        return false; // full
+
+    VkDeviceSize start = (head + 15) / 16 * 16;
+    if (head >= tail)
+    {
+        // free space is [head, capacity) followed by [0, tail)
+        if (start + size <= capacity)
+            offset = start;
+        else if (size <= tail)
+            offset = 0;
+        else
+            return false;
+    }
+    else
+    {
+        // free space is [head, tail)
+        if (start + size <= tail)
+            offset = start;
+        else
+            return false;
+    }
+    consumed = offset >= head ? offset + size - head : capacity - head + offset + size;
+    head = offset + size;
+    used += consumed;
+    return true;
+}
+
+bool UploadBatchObj::handoffNext(bool block)
+{
+    // submissions are handed off in order, so the first one not handed off is the only candidate
+    Submission *next{nullptr};
+    for (uint32_t i{0}; i < pendingCount && !next; ++i)
+    {
+        Submission &submission = submissions[(oldest + i) % submissions.size()];
+        if (!submission.handedOff)
+            next = &submission;
+    }
+    if (!next)
+        return false;
+    if (block)
+        vkCheck(vkWaitForFences(logDevice, 1, &next->transferFence, VK_TRUE, UINT64_MAX),
+                "failed to wait for upload");
+    else if (vkGetFenceStatus(logDevice, next->transferFence) != VK_SUCCESS)
+        return false;
+
+    // the copies already finished, so waiting on the semaphore never holds the consuming queue back
+    vkResetFences(logDevice, 1, &next->fence);
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &next->semaphore,
+        .pWaitDstStageMask = &consumerStages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &next->acquireBuffer,
+    };
+    vkCheck(vkQueueSubmit(dstQueue, 1, &submitInfo, next->fence), "failed to submit buffer acquire");
+    next->handedOff = true;
+    readyTicket = next->ticket;
+    return true;
+}
+
+void UploadBatchObj::handoff(bool block)
+{
+    while (handoffNext(block))
+    {
+    }
+}
+
+bool UploadBatchObj::isReady(uint64_t ticket) const
+{
+    return ticket <= readyTicket;
+}
+
+bool UploadBatchObj::retireOldest(bool block)
+{
+    if (pendingCount == 0)
+        return false;
+    Submission &oldestSubmission = submissions[oldest];
+    if (!oldestSubmission.handedOff && !handoffNext(block))
+        return false;
+    if (block)
+        vkCheck(vkWaitForFences(logDevice, 1, &oldestSubmission.fence, VK_TRUE, UINT64_MAX),
+                "failed to wait for upload");
+    else if (vkGetFenceStatus(logDevice, oldestSubmission.fence) != VK_SUCCESS)
+        return false;
+
+    tail = (tail + oldestSubmission.ringBytes) % capacity;
+    used -= oldestSubmission.ringBytes;
+    completedTicket = oldestSubmission.ticket;
+    oldestSubmission.pending = false;
+    oldestSubmission.handedOff = false;
+    oldest = (oldest + 1) % submissions.size();
+    pendingCount--;
+    return true;
+}
+
+void UploadBatchObj::beginRecording()
+{
+    if (recording != UINT32_MAX)
+        return;
+    if (pendingCount == submissions.size())
+        retireOldest(true);
+
+    recording = (oldest + pendingCount) % submissions.size();
+    Submission &submission = submissions[recording];
+    submission.ticket = nextTicket;
+    submission.ringBytes = 0;
+    submission.regions.clear();
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkCheck(vkBeginCommandBuffer(submission.commandBuffer, &beginInfo), "failed to record upload buffer");
+}
+
+uint64_t UploadBatchObj::enqueue(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size)
+{
+    const char *src = static_cast<const char *>(data);
+    return enqueue(dst, dstOffset, size, [&](void *staging, VkDeviceSize offset, VkDeviceSize chunk) {
+        memcpy(staging, src + offset, (size_t)chunk);
+    });
+}
+
+uint64_t UploadBatchObj::enqueue(
+    VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size,
+    const std::function<void(void *staging, VkDeviceSize offset, VkDeviceSize chunk)> &fill)
+{
+    uint64_t ticket{completedTicket};
+    VkDeviceSize filled{0};
+    while (size > 0)
+    {
+        // uploads bigger than the ring are split at multiples of 16 bytes so no chunk ends inside an element fill
+        // converts, everything else lands in one contiguous range
+        VkDeviceSize chunk = std::min(size, capacity / 16 * 16);
+        VkDeviceSize offset, consumed;
+        if (recording != UINT32_MAX && submissions[recording].regions.size() == maxRegions)
+            submit();
+        while (!reserve(chunk, offset, consumed))
+        {
+            if (recording != UINT32_MAX)
+                submit();
+            else if (!retireOldest(true))
+                throw std::runtime_error("failed to reserve staging memory");
+        }
+        beginRecording();
+        submissions[recording].ringBytes += consumed;
+
+        fill(static_cast<char *>(stagingMemory.mapped) + offset, filled, chunk);
+        VkBufferCopy copyRegion{
+            .srcOffset = offset,
+            .dstOffset = dstOffset,
+            .size = chunk,
+        };
+        vkCmdCopyBuffer(submissions[recording].commandBuffer, staging, dst, 1, &copyRegion);
+        // chunks of one upload are contiguous and merge into a single range
+        std::vector<Region> &regions = submissions[recording].regions;
+        if (ownershipTransfer())
+        {
+            if (!regions.empty() && regions.back().buffer == dst &&
+                regions.back().offset + regions.back().size == dstOffset)
+                regions.back().size += chunk;
+            else
+                regions.push_back({dst, dstOffset, chunk});
+        }
+
+        ticket = submissions[recording].ticket;
+        filled += chunk;
+        dstOffset += chunk;
+        size -= chunk;
+    }
+    return ticket;
+}
+
+uint64_t UploadBatchObj::submit()
+{
+    if (recording == UINT32_MAX)
+        return nextTicket - 1;
+    Submission &submission = submissions[recording];
+
+    if (!ownershipTransfer())
+    {
+        // make the copies visible to every stage that may consume uploaded buffers in later submissions
+        VkMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = consumerAccess,
+        };
+        vkCmdPipelineBarrier(submission.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0, 1, &barrier,
+                             0, nullptr, 0, nullptr);
+        vkCheck(vkEndCommandBuffer(submission.commandBuffer), "failed to record upload buffer");
+
+        vkResetFences(logDevice, 1, &submission.fence);
+        VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &submission.commandBuffer,
+        };
+        vkCheck(vkQueueSubmit(queue, 1, &submitInfo, submission.fence), "failed to submit uploads");
+        // same queue, submission order already makes the buffers safe to use
+        submission.handedOff = true;
+        readyTicket = submission.ticket;
+    }
+    else
+    {
+        // release the destinations to the consuming family, the matching acquire is recorded right away and
+        // submitted by handoff() once the copies are done
+        barriers.resize(submission.regions.size());
+        for (uint32_t i{0}; i < barriers.size(); ++i)
+        {
+            barriers[i] = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .srcQueueFamilyIndex = queueFamily,
+                .dstQueueFamilyIndex = dstFamily,
+                .buffer = submission.regions[i].buffer,
+                .offset = submission.regions[i].offset,
+                .size = submission.regions[i].size,
+            };
+        }
+        vkCmdPipelineBarrier(submission.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, barriers.size(), barriers.data(),
+                             0, nullptr);
+        vkCheck(vkEndCommandBuffer(submission.commandBuffer), "failed to record upload buffer");
+
+        for (uint32_t i{0}; i < barriers.size(); ++i)
+        {
+            barriers[i].srcAccessMask = 0;
+            barriers[i].dstAccessMask = consumerAccess;
+        }
+        VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        vkCheck(vkBeginCommandBuffer(submission.acquireBuffer, &beginInfo), "failed to record acquire buffer");
+        vkCmdPipelineBarrier(submission.acquireBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, consumerStages, 0, 0,
+                             nullptr, barriers.size(), barriers.data(), 0, nullptr);
+        vkCheck(vkEndCommandBuffer(submission.acquireBuffer), "failed to record acquire buffer");
+
+        vkResetFences(logDevice, 1, &submission.transferFence);
+        VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &submission.commandBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &submission.semaphore,
+        };
+        vkCheck(vkQueueSubmit(queue, 1, &submitInfo, submission.transferFence), "failed to submit uploads");
+    }
+
+    submission.pending = true;
+    pendingCount++;
+    recording = UINT32_MAX;
+    nextTicket++;
+    return submission.ticket;
+}
+
+bool UploadBatchObj::isComplete(uint64_t ticket)
+{
+    while (retireOldest(false))
+    {
+    }
+    return ticket <= completedTicket;
+}
+
+void UploadBatchObj::wait(uint64_t ticket)
+{
+    if (recording != UINT32_MAX && submissions[recording].ticket <= ticket)
+        submit();
+    while (completedTicket < ticket && retireOldest(true))
+    {
+    }
+}
+
+UploadBatchObj::~UploadBatchObj()
+{
+    while (retireOldest(true))
+    {
+    }
+    for (uint32_t i{0}; i < submissions.size(); ++i)
+    {
+        vkDestroyFence(logDevice, submissions[i].fence, nullptr);
+        if (ownershipTransfer())
+        {
+            vkDestroyFence(logDevice, submissions[i].transferFence, nullptr);
+            vkDestroySemaphore(logDevice, submissions[i].semaphore, nullptr);
+        }
+    }
+    if (ownershipTransfer())
+        vkDestroyCommandPool(logDevice, dstPool, nullptr);
+    vkDestroyCommandPool(logDevice, pool, nullptr);
+    vkDestroyBuffer(logDevice, staging, nullptr);
+    allocator->free(stagingMemory);
+}
+
+} // namespace Cthovk
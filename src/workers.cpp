@@ -0,0 +1,104 @@
+#include "../headers/workers.h"
+
+namespace Cthovk
+{
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+{
+    // the calling thread is one of them
+    for (uint32_t i{1}; i < threadCount; ++i)
+    {
+        threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+uint32_t WorkerPool::size() const
+{
+    return static_cast<uint32_t>(threads.size()) + 1;
+}
+
+void WorkerPool::run(const std::function<void(uint32_t task)> &newJob, uint32_t newTaskCount)
+{
+    if (threads.empty())
+    {
+        for (uint32_t i{0}; i < newTaskCount; ++i)
+        {
+            newJob(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &newJob;
+        taskCount = newTaskCount;
+        nextTask = 0;
+        finishedTasks = 0;
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+    drain();
+
+    // no worker may still hold this job once the next one is published
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return finishedTasks == taskCount && activeThreads == 0; });
+    job = nullptr;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void WorkerPool::drain()
+{
+    for (uint32_t task = nextTask++; task < taskCount; task = nextTask++)
+    {
+        try
+        {
+            (*job)(task);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++finishedTasks == taskCount)
+            done.notify_all();
+    }
+}
+
+void WorkerPool::work()
+{
+    uint64_t seen{0};
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || (generation != seen && job != nullptr); });
+            if (stopping)
+                return;
+            seen = generation;
+            activeThreads++;
+        }
+        drain();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeThreads == 0)
+            done.notify_all();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (uint32_t i{0}; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+}
+
+} // namespace Cthovk
@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "../headers/meshfile.h"
+#include "../headers/meshoptimize.h"
+#include "../headers/objimport.h"
+
+// random coloring function
+static glm::vec3 colorize(const glm::vec3 &pos)
+{
+    return {
+        std::abs(pos.y) * (std::abs(pos.x) + std::abs(pos.z)) + 0.2f,
+        0.0f,
+        std::abs(pos.y) * (std::abs(pos.z) + std::abs(pos.x)) + 0.2f,
+    };
+}
+
+int main(int argc, char **argv)
+{
+    bool optimize = argc == 4 && std::string(argv[1]) == "--optimize";
+    if (argc != 3 + optimize)
+    {
+        std::fprintf(stderr, "usage: %s [--optimize] input.obj output.cmesh\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *input = argv[1 + optimize];
+    const char *output = argv[2 + optimize];
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Cthovk::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Cthovk::WorkerPool workers(std::max(1u, std::thread::hardware_concurrency()));
+        Cthovk::importObj(input, workers, vertices, indices, colorize);
+        if (optimize)
+        {
+            Cthovk::MeshOptimizeStats stats = Cthovk::optimizeMesh(vertices, indices);
+            std::printf("%s: acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", output, stats.before.acmr, stats.after.acmr,
+                        stats.before.atvr, stats.after.atvr);
+        }
+        Cthovk::writeMeshFile(output, vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(),
+                              static_cast<uint32_t>(indices.size()),
+                              optimize ? Cthovk::MeshFileHeader::TRIANGLE_ORDER : 0);
+        auto end = std::chrono::steady_clock::now();
+        std::printf("%s: %zu vertices, %zu indices, %.1fms\n", output, vertices.size(), indices.size(),
+                    std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}